@@ -0,0 +1,202 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "mockmodelserver.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+static quint16 floatToHalf(float value)
+{
+    quint32 bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    const quint16 sign = static_cast<quint16>((bits >> 16) & 0x8000);
+    const int exp = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    quint32 mant = bits & 0x7fffff;
+
+    if (exp <= 0) {
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        const int shift = 14 - exp;
+        quint16 half = static_cast<quint16>(mant >> shift);
+        if ((mant >> (shift - 1)) & 1)
+            half++;
+        return sign | half;
+    }
+    if (exp >= 0x1f)
+        return sign | 0x7c00;
+
+    quint16 half = static_cast<quint16>(sign | (exp << 10) | (mant >> 13));
+    if (mant & 0x1000)
+        half++;   // 进位溢出到指数位时结果仍正确
+    return half;
+}
+
+MockModelServer::MockModelServer(const QStringList &formats, bool strict, int dim, int delay)
+    : formats(formats), strict(strict), dim(dim), delay(delay)
+{
+}
+
+QStringList MockModelServer::allFormats()
+{
+    return { "float", "base64", "binary", "binary_fp16" };
+}
+
+qint64 MockModelServer::requestCount() const
+{
+    return requests;
+}
+
+qint64 MockModelServer::textCount() const
+{
+    return texts;
+}
+
+void MockModelServer::incomingConnection(qintptr handle)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(handle);
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        pending.remove(socket);
+        socket->deleteLater();
+    });
+}
+
+void MockModelServer::onReadyRead(QTcpSocket *socket)
+{
+    QByteArray &buffer = pending[socket];
+    buffer += socket->readAll();
+
+    forever {
+        int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0)
+            return;
+
+        const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+        const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        int length = 0;
+        for (const QByteArray &line : lines) {
+            if (line.toLower().startsWith("content-length:"))
+                length = line.mid(15).trimmed().toInt();
+        }
+        if (buffer.size() < headerEnd + 4 + length)
+            return;
+
+        const QByteArray body = buffer.mid(headerEnd + 4, length);
+        buffer.remove(0, headerEnd + 4 + length);
+
+        const QByteArray path = requestLine.value(1);
+        auto handle = [this, socket, path, body]() {
+            if (path == "/health")
+                reply(socket, 200, "application/json", "{\"status\":\"ok\"}");
+            else if (path == "/embeddings")
+                embeddings(socket, body);
+            else
+                reply(socket, 404, "text/plain", "not found");
+        };
+
+        // 延迟用定时器而非休眠，多个连接上的请求可以同时等待，与真实服务的并发行为一致
+        if (delay > 0) {
+            QPointer<QTcpSocket> guard(socket);
+            QTimer::singleShot(delay, this, [guard, handle]() {
+                if (guard)
+                    handle();
+            });
+        } else {
+            handle();
+        }
+    }
+}
+
+void MockModelServer::embeddings(QTcpSocket *socket, const QByteArray &body)
+{
+    QJsonObject request = QJsonDocument::fromJson(body).object();
+    QString format = request.value("encoding_format").toString("float");
+    if (!formats.contains(format)) {
+        if (strict) {
+            reply(socket, 400, "application/json", "{\"error\":\"unsupported encoding_format\"}");
+            return;
+        }
+        format = "float";
+    }
+
+    const QJsonArray input = request.value("input").toArray();
+    requests++;
+    texts += input.size();
+
+    QVector<float> vectors(input.size() * dim);
+    for (int i = 0; i < input.size(); i++) {
+        // 相同文本得到相同向量
+        QRandomGenerator gen(qHash(input.at(i).toString()));
+        for (int j = 0; j < dim; j++)
+            vectors[i * dim + j] = static_cast<float>(gen.generateDouble() * 0.2 - 0.1);
+    }
+
+    if (format.startsWith("binary")) {
+        const bool fp16 = format == "binary_fp16";
+        QByteArray frame("EMBB");
+        uchar head[12];
+        qToLittleEndian<quint32>(static_cast<quint32>(input.size()), head);
+        qToLittleEndian<quint32>(static_cast<quint32>(dim), head + 4);
+        qToLittleEndian<quint32>(fp16 ? 1 : 0, head + 8);
+        frame.append(reinterpret_cast<const char *>(head), sizeof(head));
+        for (float v : vectors) {
+            uchar bytes[4];
+            if (fp16) {
+                qToLittleEndian<quint16>(floatToHalf(v), bytes);
+                frame.append(reinterpret_cast<const char *>(bytes), 2);
+            } else {
+                quint32 bits = 0;
+                memcpy(&bits, &v, sizeof(bits));
+                qToLittleEndian<quint32>(bits, bytes);
+                frame.append(reinterpret_cast<const char *>(bytes), 4);
+            }
+        }
+        reply(socket, 200, "application/octet-stream", frame);
+        return;
+    }
+
+    QJsonArray data;
+    for (int i = 0; i < input.size(); i++) {
+        QJsonObject item;
+        item["object"] = "embedding";
+        item["index"] = i;
+        if (format == "base64") {
+            QByteArray raw(reinterpret_cast<const char *>(vectors.constData() + i * dim),
+                           static_cast<int>(sizeof(float)) * dim);
+            item["embedding"] = QString::fromLatin1(raw.toBase64());
+        } else {
+            QJsonArray embedding;
+            for (int j = 0; j < dim; j++)
+                embedding.append(static_cast<double>(vectors[i * dim + j]));
+            item["embedding"] = embedding;
+        }
+        data.append(item);
+    }
+
+    QJsonObject obj;
+    obj["object"] = "list";
+    obj["data"] = data;
+    reply(socket, 200, "application/json", QJsonDocument(obj).toJson(QJsonDocument::Compact));
+}
+
+void MockModelServer::reply(QTcpSocket *socket, int status, const QByteArray &type, const QByteArray &body)
+{
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + (status == 200 ? " OK" : " Error") + "\r\n";
+    head += "Content-Type: " + type + "\r\n";
+    head += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    head += "Connection: keep-alive\r\n\r\n";
+    socket->write(head + body);
+}
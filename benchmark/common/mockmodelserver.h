@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef MOCKMODELSERVER_H
+#define MOCKMODELSERVER_H
+
+#include <QHash>
+#include <QStringList>
+#include <QTcpServer>
+
+#include <atomic>
+
+class QTcpSocket;
+
+// 模拟 modelhub 的模型服务，只实现 keep-alive 下的 GET /health 与 POST /embeddings
+// 相同文本得到相同向量；支持 formats 中的 encoding_format，其余请求按 strict 返回 400 或忽略并返回 JSON 数组
+// 每个请求处理前等待 delay 毫秒，模拟模型推理耗时
+class MockModelServer : public QTcpServer
+{
+public:
+    MockModelServer(const QStringList &formats, bool strict, int dim, int delay);
+
+    static QStringList allFormats();
+
+    qint64 requestCount() const;
+    qint64 textCount() const;
+
+protected:
+    void incomingConnection(qintptr handle) override;
+
+private:
+    void onReadyRead(QTcpSocket *socket);
+    void embeddings(QTcpSocket *socket, const QByteArray &body);
+    void reply(QTcpSocket *socket, int status, const QByteArray &type, const QByteArray &body);
+
+    QStringList formats;
+    bool strict = false;
+    int dim = 1024;
+    int delay = 0;
+    QHash<QTcpSocket *, QByteArray> pending;
+    std::atomic<qint64> requests { 0 };
+    std::atomic<qint64> texts { 0 };
+};
+
+#endif // MOCKMODELSERVER_H
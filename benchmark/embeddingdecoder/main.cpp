@@ -0,0 +1,103 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "index/vectorindex/embeddingdecoder.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QRandomGenerator>
+#include <QVector>
+
+#include <iostream>
+
+// 用法：embeddingdecoder-benchmark [-b 15] [-d 1024] [-r 200]
+// 构造与模型服务相同格式的响应，对比 QJsonDocument 逐元素转换与 EmbeddingDecoder 的解析耗时
+
+static QByteArray makeResponse(int batch, int dim)
+{
+    QJsonArray data;
+    for (int i = 0; i < batch; i++) {
+        QJsonArray embedding;
+        for (int j = 0; j < dim; j++)
+            embedding.append(QRandomGenerator::global()->generateDouble() * 0.2 - 0.1);
+
+        QJsonObject item;
+        item["object"] = "embedding";
+        item["index"] = i;
+        item["embedding"] = embedding;
+        data.append(item);
+    }
+
+    QJsonObject obj;
+    obj["object"] = "list";
+    obj["data"] = data;
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+// 与原 Embedding::embeddingTexts 中的解析方式一致
+static QVector<QVector<float>> decodeByQJson(const QByteArray &response)
+{
+    QJsonArray embeddingsArray = QJsonDocument::fromJson(response).object()["data"].toArray();
+    QVector<QVector<float>> vectors;
+    for (auto embeddingObject : embeddingsArray) {
+        QJsonArray vectorArray = embeddingObject.toObject()["embedding"].toArray();
+        QVector<float> vectorTmp;
+        for (auto value : vectorArray)
+            vectorTmp << static_cast<float>(value.toDouble());
+        vectors << vectorTmp;
+    }
+    return vectors;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "b", "Vectors per response.", "count", "15" });
+    parser.addOption({ "d", "Dimension.", "dim", "1024" });
+    parser.addOption({ "r", "Rounds.", "count", "200" });
+    parser.process(app);
+
+    const int batch = parser.value("b").toInt();
+    const int dim = parser.value("d").toInt();
+    const int rounds = parser.value("r").toInt();
+
+    const QByteArray response = makeResponse(batch, dim);
+
+    QVector<QVector<float>> expected = decodeByQJson(response);
+    QVector<QVector<float>> actual;
+    if (!EmbeddingDecoder::decode(response, batch, actual) || actual.size() != expected.size()) {
+        std::cerr << "decoder failed" << std::endl;
+        return 1;
+    }
+
+    double maxError = 0;
+    for (int i = 0; i < expected.size(); i++) {
+        for (int j = 0; j < dim; j++)
+            maxError = qMax(maxError, static_cast<double>(qAbs(expected[i][j] - actual[i][j])));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < rounds; i++)
+        expected = decodeByQJson(response);
+    const double qjsonMs = timer.nsecsElapsed() / 1e6 / rounds;
+
+    timer.restart();
+    for (int i = 0; i < rounds; i++)
+        EmbeddingDecoder::decode(response, batch, actual);
+    const double decoderMs = timer.nsecsElapsed() / 1e6 / rounds;
+
+    std::cout << "response " << response.size() / 1024 << " KB, " << batch << " x " << dim << std::endl;
+    std::cout << "QJsonDocument:    " << qjsonMs << " ms/response" << std::endl;
+    std::cout << "EmbeddingDecoder: " << decoderMs << " ms/response" << std::endl;
+    std::cout << "speedup " << qjsonMs / decoderMs << "x, max abs error " << maxError << std::endl;
+    return 0;
+}
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "common/mockmodelserver.h"
+#include "index/vectorindex/embeddingdecoder.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QThread>
+
+#include <iostream>
+
+// 用法：
+//   embeddingwire-benchmark [-b 15] [-d 1024] [-r 50] [--formats float,base64,binary,binary_fp16] [--strict]
+//       在进程内启动模拟的模型服务，依次用各编码请求 /embeddings，输出协商结果、传输量与耗时
+//   embeddingwire-benchmark --serve [--port 8090] [--formats ...] [--strict] [--delay 0]
+//       只运行模拟服务，可用于联调向量索引服务
+//   embeddingwire-benchmark --url http://127.0.0.1:8090
+//       对已有的服务(如真实的模型服务)测试各编码
+// 模拟服务只支持 --formats 中的编码，其余请求按 --strict 返回 400 或忽略并返回 JSON 数组
+
+static const QStringList kFormats = MockModelServer::allFormats();
+
+static bool post(QNetworkAccessManager &manager, const QString &url, const QByteArray &body,
+                 QByteArray &out, int &status)
+{
+    QNetworkRequest request { QUrl(url) };
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QNetworkReply *reply = manager.post(request, body);
+
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    bool ok = reply->error() == QNetworkReply::NoError;
+    out = reply->readAll();
+    reply->deleteLater();
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "serve", "Only run the mock model server." });
+    parser.addOption({ "url", "Benchmark an existing server instead of the mock one.", "url" });
+    parser.addOption({ "port", "Port of the mock server.", "port", "0" });
+    parser.addOption({ "formats", "Encodings supported by the mock server.", "list", kFormats.join(",") });
+    parser.addOption({ "strict", "Reply 400 for unsupported encodings instead of ignoring them." });
+    parser.addOption({ "delay", "Mock server delay per request.", "ms", "0" });
+    parser.addOption({ "b", "Texts per request.", "count", "15" });
+    parser.addOption({ "d", "Dimension of the mock server.", "dim", "1024" });
+    parser.addOption({ "r", "Requests per encoding.", "count", "50" });
+    parser.process(app);
+
+    const QStringList formats = parser.value("formats").split(',', QString::SkipEmptyParts);
+    const int dim = parser.value("d").toInt();
+
+    QThread serverThread;
+    MockModelServer *server = nullptr;
+    QString url = parser.value("url");
+    if (url.isEmpty()) {
+        server = new MockModelServer(formats, parser.isSet("strict"), dim, parser.value("delay").toInt());
+        const bool serveOnly = parser.isSet("serve");
+        if (!serveOnly) {
+            // 模拟服务在独立线程中监听，主线程作为客户端
+            server->moveToThread(&serverThread);
+            QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+            serverThread.start();
+        }
+
+        bool listening = false;
+        const quint16 port = static_cast<quint16>(parser.value("port").toUInt());
+        QMetaObject::invokeMethod(server, [server, port, &listening]() {
+            listening = server->listen(QHostAddress::LocalHost, port);
+        }, serveOnly ? Qt::DirectConnection : Qt::BlockingQueuedConnection);
+        if (!listening) {
+            std::cerr << "listen failed: " << server->errorString().toStdString() << std::endl;
+            serverThread.quit();
+            serverThread.wait();
+            return 1;
+        }
+
+        url = QString("http://127.0.0.1:%0").arg(server->serverPort());
+        std::cout << "mock server " << url.toStdString() << " formats " << formats.join(",").toStdString()
+                  << std::endl;
+
+        if (serveOnly)
+            return app.exec();
+    }
+
+    const int batch = parser.value("b").toInt();
+    const int rounds = parser.value("r").toInt();
+    QJsonArray input;
+    for (int i = 0; i < batch; i++)
+        input.append(QString("用于测试向量化传输格式的文本块 %0").arg(i).repeated(10));
+
+    QNetworkAccessManager manager;
+    for (const QString &format : kFormats) {
+        QJsonObject request;
+        request["input"] = input;
+        if (format != "float")
+            request["encoding_format"] = format;
+        const QByteArray body = QJsonDocument(request).toJson(QJsonDocument::Compact);
+
+        qint64 bytes = 0;
+        qint64 decodeNs = 0;
+        int status = 0;
+        int answered = -1;
+        bool failed = false;
+        QElapsedTimer total;
+        total.start();
+        for (int i = 0; i < rounds && !failed; i++) {
+            QByteArray response;
+            if (!post(manager, url + "/embeddings", body, response, status)) {
+                failed = true;
+                break;
+            }
+
+            answered = EmbeddingDecoder::encoding(response);
+            bytes += response.size();
+
+            QElapsedTimer timer;
+            timer.start();
+            QVector<QVector<float>> vectors;
+            if (!EmbeddingDecoder::decode(response, batch, vectors))
+                failed = true;
+            decodeNs += timer.nsecsElapsed();
+        }
+
+        std::cout << format.toStdString() << ": ";
+        if (failed && answered < 0) {
+            std::cout << "rejected, http status " << status << std::endl;
+            continue;
+        }
+        if (failed) {
+            std::cout << "undecodable response" << std::endl;
+            continue;
+        }
+
+        std::cout << "answered as " << kFormats.value(answered).toStdString()
+                  << ", " << bytes / rounds / 1024 << " KB/request"
+                  << ", " << total.elapsed() / static_cast<double>(rounds) << " ms/request"
+                  << ", decode " << decodeNs / 1e6 / rounds << " ms/request" << std::endl;
+    }
+
+    if (server) {
+        serverThread.quit();
+        serverThread.wait();
+    }
+    return 0;
+}
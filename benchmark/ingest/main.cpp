@@ -0,0 +1,517 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "common/mockmodelserver.h"
+#include "config/configmanager.h"
+#include "database/embeddatabase.h"
+#include "index/embeddingworker.h"
+#include "index/global_define.h"
+#include "index/vectorindex/chunkembeddingcache.h"
+#include "index/vectorindex/embeddingbackend.h"
+#include "index/vectorindex/lanescheduler.h"
+#include "index/vectorindex/queryembeddingcache.h"
+#include "modelhub/modelhubclient.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QScopedPointer>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+// 用法：
+//   ingest-benchmark [--docs 200] [--mix txt,docx,pdf] [--size 8] [--batch 20] [--queries 200] [-k 10]
+//                    [--delay 20] [--backend mock|stub] [--url http://127.0.0.1:8090] [--set Key=Value ...] [--during]
+//                    [--churn]
+// 生成合成语料(txt/docx 为中英混排，pdf 只含英文)，通过 EmbeddingWorker::doCreateIndex 建索引并落盘，
+// 再以语料中的片段调用 doVectorSearch，输出 docs/s、chunks/s、检索延迟 p50/p99 与峰值 RSS
+// 默认向进程内模拟的模型服务请求向量(每个请求延迟 --delay 毫秒)；--backend stub 使用进程内哈希向量；
+// --url 指向已有的模型服务。--set 写入 VectorIndex 配置组，可对比不同参数
+// --during 在入库期间另起线程定时检索(查询互不相同，需请求模型服务)，输出入库期间的检索延迟
+// --churn 每批入库后删除该批中间的一个文档再继续追加，落盘后校验段表与元数据一致(缓存 id 不连续时不重复入库)
+// 数据目录使用 QStandardPaths 测试模式下的位置，每次运行前清空，不影响本机的索引
+
+static constexpr char kAppID[] { "dde-grand-search" };
+static constexpr int kEmbeddingTimeout { 60 * 1000 };
+static constexpr int kPdfLinesPerPage { 50 };
+static constexpr int kPdfLineChars { 90 };
+static constexpr int kDuringInterval { 20 };   // ms，入库期间两次检索的间隔
+
+static const QStringList kChineseWords {
+    "向量", "索引", "检索", "文档", "模型", "服务", "数据", "系统", "文件", "用户",
+    "配置", "性能", "内存", "磁盘", "网络", "线程", "队列", "缓存", "查询", "结果",
+    "深度", "操作", "桌面", "环境", "应用", "窗口", "设置", "更新", "安装", "语言"
+};
+
+static const QStringList kEnglishWords {
+    "vector", "index", "search", "document", "model", "service", "data", "system", "file", "user",
+    "config", "latency", "memory", "disk", "network", "thread", "queue", "cache", "query", "result",
+    "deepin", "desktop", "window", "kernel", "package", "update", "install", "language", "segment", "batch"
+};
+
+struct ApiContext
+{
+    ModelhubClient *client = nullptr;
+    EmbeddingBackend *backend = nullptr;
+    QString url;
+    std::atomic<qint64> texts { 0 };
+    std::atomic<qint64> failures { 0 };
+};
+
+static QByteArray embeddingApi(const QStringList &texts, void *user)
+{
+    ApiContext *ctx = static_cast<ApiContext *>(user);
+    ctx->texts += texts.size();
+
+    if (ctx->backend)
+        return ctx->backend->embed(texts);
+
+    QJsonObject data;
+    data["input"] = QJsonArray::fromStringList(texts);
+    data["encoding_format"] = "binary";
+
+    QByteArray response;
+    if (!ctx->client->postSync(ctx->url + "/embeddings", QJsonDocument(data).toJson(QJsonDocument::Compact),
+                               kEmbeddingTimeout, response, nullptr, LaneScheduler::inQuery())) {
+        ctx->failures++;
+        return {};
+    }
+    return response;
+}
+
+static QString sentence(QRandomGenerator &gen, bool chinese)
+{
+    const QStringList &words = chinese ? kChineseWords : kEnglishWords;
+    const int count = gen.bounded(8, 20);
+    QStringList parts;
+    for (int i = 0; i < count; i++)
+        parts << words.at(gen.bounded(words.size()));
+    return chinese ? parts.join("") + "。" : parts.join(" ") + ". ";
+}
+
+static QString paragraph(QRandomGenerator &gen, int bytes, bool chinese)
+{
+    QString text;
+    while (text.toUtf8().size() < bytes) {
+        for (int i = 0; i < 6; i++)
+            text += sentence(gen, chinese && gen.bounded(3) != 0);
+        text += "\n";
+    }
+    return text;
+}
+
+static quint32 crc32(const QByteArray &data)
+{
+    static quint32 table[256] = { 0 };
+    if (!table[1]) {
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+
+    quint32 crc = 0xffffffffu;
+    for (char ch : data)
+        crc = table[(crc ^ static_cast<uchar>(ch)) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+// 只存储不压缩的 zip，足够文档解析器读取
+static bool writeZip(const QString &path, const QList<QPair<QByteArray, QByteArray>> &entries)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray central;
+    QDataStream cd(&central, QIODevice::WriteOnly);
+    cd.setByteOrder(QDataStream::LittleEndian);
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    for (const auto &entry : entries) {
+        const quint32 offset = static_cast<quint32>(file.pos());
+        const quint32 crc = crc32(entry.second);
+        const quint32 size = static_cast<quint32>(entry.second.size());
+        const quint16 nameLen = static_cast<quint16>(entry.first.size());
+
+        out << quint32(0x04034b50) << quint16(20) << quint16(0) << quint16(0) << quint16(0) << quint16(0x21)
+            << crc << size << size << nameLen << quint16(0);
+        out.writeRawData(entry.first.constData(), entry.first.size());
+        out.writeRawData(entry.second.constData(), entry.second.size());
+
+        cd << quint32(0x02014b50) << quint16(20) << quint16(20) << quint16(0) << quint16(0) << quint16(0)
+           << quint16(0x21) << crc << size << size << nameLen << quint16(0) << quint16(0) << quint16(0)
+           << quint16(0) << quint32(0) << offset;
+        cd.writeRawData(entry.first.constData(), entry.first.size());
+    }
+
+    const quint32 cdOffset = static_cast<quint32>(file.pos());
+    out.writeRawData(central.constData(), central.size());
+    out << quint32(0x06054b50) << quint16(0) << quint16(0) << quint16(entries.size())
+        << quint16(entries.size()) << quint32(central.size()) << cdOffset << quint16(0);
+    return out.status() == QDataStream::Ok;
+}
+
+static bool writeDocx(const QString &path, const QString &text)
+{
+    QByteArray body;
+    for (const QString &line : text.split('\n', QString::SkipEmptyParts))
+        body += "<w:p><w:r><w:t>" + line.toHtmlEscaped().toUtf8() + "</w:t></w:r></w:p>";
+
+    const QByteArray document =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+            "<w:document xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\"><w:body>"
+            + body + "</w:body></w:document>";
+    const QByteArray types =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+            "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+            "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+            "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+            "<Override PartName=\"/word/document.xml\" "
+            "ContentType=\"application/vnd.openxmlformats-officedocument.wordprocessingml.document.main+xml\"/>"
+            "</Types>";
+    const QByteArray rels =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+            "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+            "<Relationship Id=\"rId1\" "
+            "Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument\" "
+            "Target=\"word/document.xml\"/></Relationships>";
+
+    return writeZip(path, { { "[Content_Types].xml", types }, { "_rels/.rels", rels },
+                            { "word/document.xml", document } });
+}
+
+// 标准 14 字体的最小 PDF，只能写入 ASCII 文本
+static bool writePdf(const QString &path, const QString &text)
+{
+    QStringList lines;
+    for (QString line : text.split('\n', QString::SkipEmptyParts)) {
+        while (!line.isEmpty()) {
+            lines << line.left(kPdfLineChars);
+            line.remove(0, kPdfLineChars);
+        }
+    }
+
+    QList<QByteArray> objects;
+    objects << "<< /Type /Catalog /Pages 2 0 R >>";
+    objects << QByteArray();   // 页树，页数确定后再填写
+    objects << "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>";
+
+    QByteArray kids;
+    for (int start = 0; start < lines.size(); start += kPdfLinesPerPage) {
+        QByteArray content = "BT /F1 10 Tf 14 TL 50 750 Td";
+        for (const QString &line : lines.mid(start, kPdfLinesPerPage)) {
+            QByteArray escaped = line.toLatin1();
+            escaped.replace('\\', "\\\\").replace('(', "\\(").replace(')', "\\)");
+            content += " (" + escaped + ") Tj T*";
+        }
+        content += " ET";
+
+        const int pageID = objects.size() + 1;
+        objects << "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> "
+                   "/Contents " + QByteArray::number(pageID + 1) + " 0 R >>";
+        objects << "<< /Length " + QByteArray::number(content.size()) + " >>\nstream\n" + content + "\nendstream";
+        kids += QByteArray::number(pageID) + " 0 R ";
+    }
+    objects[1] = "<< /Type /Pages /Kids [" + kids.trimmed() + "] /Count "
+            + QByteArray::number((objects.size() - 3) / 2) + " >>";
+
+    QByteArray pdf = "%PDF-1.4\n";
+    QList<int> offsets;
+    for (int i = 0; i < objects.size(); i++) {
+        offsets << pdf.size();
+        pdf += QByteArray::number(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+
+    const int xref = pdf.size();
+    pdf += "xref\n0 " + QByteArray::number(objects.size() + 1) + "\n0000000000 65535 f \n";
+    for (int offset : offsets)
+        pdf += QString("%1 00000 n \n").arg(offset, 10, 10, QChar('0')).toLatin1();
+    pdf += "trailer\n<< /Size " + QByteArray::number(objects.size() + 1) + " /Root 1 0 R >>\nstartxref\n"
+            + QByteArray::number(xref) + "\n%%EOF\n";
+
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(pdf) == pdf.size();
+}
+
+static QStringList generateCorpus(const QString &dir, int docs, const QStringList &mix, int bytes,
+                                  QStringList &samples)
+{
+    QRandomGenerator gen(20240601);
+    QStringList files;
+    for (int i = 0; i < docs; i++) {
+        const QString suffix = mix.at(i % mix.size());
+        const QString text = paragraph(gen, bytes, suffix != "pdf");
+        const QString path = QString("%0/doc%1.%2").arg(dir).arg(i, 5, 10, QChar('0')).arg(suffix);
+
+        bool ok = false;
+        if (suffix == "docx") {
+            ok = writeDocx(path, text);
+        } else if (suffix == "pdf") {
+            ok = writePdf(path, text);
+        } else {
+            QFile file(path);
+            ok = file.open(QIODevice::WriteOnly) && file.write(text.toUtf8()) > 0;
+        }
+
+        if (!ok) {
+            std::cerr << "failed to write " << path.toStdString() << std::endl;
+            continue;
+        }
+        files << path;
+
+        // 查询取自语料中的句子
+        const QStringList lines = text.split('\n', QString::SkipEmptyParts);
+        samples << lines.at(gen.bounded(lines.size())).left(40);
+    }
+    return files;
+}
+
+// 配置在 ConfigManager 初始化前写入，避免依赖文件监视的延迟加载
+static void writeConfig(const QStringList &overrides)
+{
+    const QString path = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/"
+            + QCoreApplication::organizationName() + "/" + QCoreApplication::applicationName() + "/"
+            + QCoreApplication::applicationName() + ".conf";
+    QFile::remove(path);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSettings set(path, QSettings::IniFormat);
+    set.beginGroup(VECTOR_INDEX_GROUP);
+    for (const QString &item : overrides) {
+        const int pos = item.indexOf('=');
+        if (pos > 0)
+            set.setValue(item.left(pos), item.mid(pos + 1));
+    }
+    set.endGroup();
+    set.sync();
+}
+
+static double percentile(QVector<double> values, double p)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    const int pos = qBound(0, static_cast<int>(p * (values.size() - 1) + 0.5), values.size() - 1);
+    return values.at(pos);
+}
+
+// 每个已入库的文本块在段表中恰有一行未删除的记录
+static bool checkIndexTables(int churned)
+{
+    const QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/"
+            + kAppID + ".db";
+    // 只读方式以 immutable 打开会忽略 WAL 中未合并的写入
+    QSqlDatabase db = EmbedDBVendorIns->addDatabase(path);
+
+    auto count = [&db](const QString &query) {
+        QList<QVariantList> result;
+        EmbedDBVendorIns->executeQuery(&db, query, result);
+        return result.isEmpty() || result[0].isEmpty() ? -1 : result[0][0].toLongLong();
+    };
+    const qint64 chunks = count("SELECT COUNT(*) FROM " + QString(kEmbeddingDBMetaDataTable));
+    const qint64 segRows = count("SELECT COUNT(*) FROM " + QString(kEmbeddingDBIndexSegTable) + " WHERE "
+                                 + QString(kEmbeddingDBSegIndexTableBitSet) + " = 0");
+    EmbedDBVendorIns->removeDatabase(&db);
+
+    std::cout << "churn " << churned << " docs deleted, " << chunks << " chunks in metadata, "
+              << segRows << " live rows in index segments" << std::endl;
+    if (chunks != segRows) {
+        std::cerr << "index segment table does not match metadata" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setOrganizationName("deepin");
+    app.setApplicationName("deepin-ai-daemon");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "docs", "Number of generated documents.", "count", "200" });
+    parser.addOption({ "mix", "Document types, generated in turn.", "list", "txt,docx,pdf" });
+    parser.addOption({ "size", "Text size of each document.", "KB", "8" });
+    parser.addOption({ "batch", "Files per doCreateIndex call.", "count", "20" });
+    parser.addOption({ "queries", "Number of searches.", "count", "200" });
+    parser.addOption({ "k", "Top k.", "k", "10" });
+    parser.addOption({ "delay", "Mock server delay per request.", "ms", "20" });
+    parser.addOption({ "backend", "Embedding source: mock or stub.", "name", "mock" });
+    parser.addOption({ "url", "Use an existing model server instead of the mock one.", "url" });
+    parser.addOption({ "set", "VectorIndex config override, may be repeated.", "key=value" });
+    parser.addOption({ "during", "Also search while indexing." });
+    parser.addOption({ "churn", "Delete a document in the middle of each batch, then check the index tables." });
+    parser.process(app);
+
+    // 数据与配置都写入测试目录
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+    writeConfig(parser.values("set"));
+    ConfigManagerIns->init();
+
+    QTemporaryDir corpusDir;
+    QStringList samples;
+    QElapsedTimer timer;
+    timer.start();
+    const QStringList files = generateCorpus(corpusDir.path(), parser.value("docs").toInt(),
+                                             parser.value("mix").split(',', QString::SkipEmptyParts),
+                                             qMax(1, parser.value("size").toInt()) * 1024, samples);
+    std::cout << "corpus " << files.size() << " files in " << timer.elapsed() << " ms" << std::endl;
+    if (files.isEmpty())
+        return 1;
+
+    ApiContext ctx;
+    QThread serverThread;
+    MockModelServer *server = nullptr;
+    QScopedPointer<EmbeddingBackend> backend;
+    QScopedPointer<ModelhubClient> client;
+    if (parser.value("backend") == "stub") {
+        backend.reset(new StubEmbeddingBackend(EmbeddingDim));
+        ctx.backend = backend.data();
+    } else {
+        ctx.url = parser.value("url");
+        if (ctx.url.isEmpty()) {
+            // 模拟服务在独立线程中监听
+            server = new MockModelServer(MockModelServer::allFormats(), false, EmbeddingDim,
+                                         parser.value("delay").toInt());
+            server->moveToThread(&serverThread);
+            QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+            serverThread.start();
+
+            bool listening = false;
+            QMetaObject::invokeMethod(server, [server, &listening]() {
+                listening = server->listen(QHostAddress::LocalHost, 0);
+            }, Qt::BlockingQueuedConnection);
+            if (!listening) {
+                std::cerr << "listen failed" << std::endl;
+                return 1;
+            }
+            ctx.url = QString("http://127.0.0.1:%0").arg(server->serverPort());
+        }
+        client.reset(new ModelhubClient(4));
+        ctx.client = client.data();
+    }
+
+    const QString model = backend ? backend->model() : QString("mock-%0").arg(EmbeddingDim);
+    QueryEmbeddingCacheIns->setModel(model);
+    ChunkEmbeddingCacheIns->setModel(model);
+
+    // 工作对象运行在自己的线程中，与服务中的调用方式一致
+    EmbeddingWorker *worker = new EmbeddingWorker(kAppID);
+    worker->setEmbeddingApi(embeddingApi, &ctx);
+    std::atomic<int> failedDocs { 0 };
+    QObject::connect(worker, &EmbeddingWorker::statusChanged, worker,
+                     [&failedDocs](const QString &, const QStringList &docs, int status) {
+        if (status != GET_INDEX_STATUS_CODE(INDEX_STATUS_SUCCESS))
+            failedDocs += docs.size();
+    }, Qt::DirectConnection);
+
+    const int k = parser.value("k").toInt();
+    std::atomic_bool ingesting { true };
+    QVector<double> duringLatency;
+    std::thread searcher;
+    if (parser.isSet("during")) {
+        searcher = std::thread([&]() {
+            for (int i = 0; ingesting; i++) {
+                QElapsedTimer t;
+                t.start();
+                worker->doVectorSearch(QString("%0 %1").arg(samples.at(i % samples.size())).arg(i), k);
+                duringLatency << t.nsecsElapsed() / 1e6;
+                QThread::msleep(kDuringInterval);
+            }
+        });
+    }
+
+    const int batch = qMax(1, parser.value("batch").toInt());
+    const bool churn = parser.isSet("churn");
+    int churned = 0;
+    timer.restart();
+    for (int start = 0; start < files.size(); start += batch) {
+        const QStringList part = files.mid(start, batch);
+        QMetaObject::invokeMethod(worker, "doCreateIndex", Qt::BlockingQueuedConnection,
+                                  Q_ARG(QStringList, part));
+
+        // 删除后缓存中的 id 出现空洞，下一批接着追加
+        if (churn && part.size() > 2) {
+            const QStringList victim { part.at(part.size() / 2) };
+            bool deleted = false;
+            QMetaObject::invokeMethod(worker, "doDeleteIndex", Qt::BlockingQueuedConnection,
+                                      Q_RETURN_ARG(bool, deleted), Q_ARG(QStringList, victim));
+            if (deleted)
+                churned++;
+        }
+    }
+    const qint64 embedMs = timer.elapsed();
+    QMetaObject::invokeMethod(worker, "doIndexDump", Qt::BlockingQueuedConnection);
+    const qint64 ingestMs = qMax<qint64>(1, timer.elapsed());
+
+    ingesting = false;
+    if (searcher.joinable())
+        searcher.join();
+
+    std::cout << "ingest " << files.size() << " docs, " << ctx.texts << " chunks in " << ingestMs << " ms"
+              << " (dump " << ingestMs - embedMs << " ms), failed docs " << failedDocs
+              << ", failed requests " << ctx.failures << std::endl;
+    std::cout << "  " << files.size() * 1000.0 / ingestMs << " docs/s, "
+              << ctx.texts * 1000.0 / ingestMs << " chunks/s" << std::endl;
+    if (server)
+        std::cout << "  model server " << server->requestCount() << " requests, "
+                  << server->textCount() << " texts" << std::endl;
+    if (churn && !checkIndexTables(churned))
+        return 1;
+    if (!duringLatency.isEmpty())
+        std::cout << "search during ingest " << duringLatency.size() << " queries, p50 "
+                  << percentile(duringLatency, 0.5) << " ms, p99 " << percentile(duringLatency, 0.99) << " ms"
+                  << std::endl;
+
+    // 与 DBus 接口相同，在调用方线程检索
+    const int queries = parser.value("queries").toInt();
+    QVector<double> latency;
+    int empty = 0;
+    for (int i = 0; i < queries; i++) {
+        QElapsedTimer t;
+        t.start();
+        const QString result = worker->doVectorSearch(samples.at(i % samples.size()), k);
+        latency << t.nsecsElapsed() / 1e6;
+
+        const QJsonObject obj = QJsonDocument::fromJson(result.toUtf8()).object();
+        if (obj.value("result").toArray().isEmpty())
+            empty++;
+    }
+    std::cout << "search " << queries << " queries, p50 " << percentile(latency, 0.5) << " ms, p99 "
+              << percentile(latency, 0.99) << " ms, empty results " << empty << std::endl;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "peak rss " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+
+    // 工作对象不析构，析构时的落盘不计入结果；退出前只停下模拟服务
+    if (server) {
+        serverThread.quit();
+        serverThread.wait();
+    }
+    return 0;
+}
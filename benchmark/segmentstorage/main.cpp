@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QSet>
+#include <QVector>
+#include <QDebug>
+
+#include <faiss/Index.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/index_factory.h>
+#include <faiss/index_io.h>
+#include <faiss/utils/random.h>
+
+#include <iostream>
+
+// 用法：segmentstorage-benchmark [--segment Flat_0.faiss] [-n 20000] [-d 1024] [-q 200] [-k 10]
+// 指定落盘的 Flat 段时使用其中的向量，否则生成随机向量；查询取自库内向量并加入扰动
+
+static void loadSegment(const QString &path, int &d, QVector<float> &embeddings)
+{
+    QScopedPointer<faiss::Index> index(faiss::read_index(path.toStdString().c_str()));
+    faiss::Index *base = index.data();
+    if (auto idMap = dynamic_cast<faiss::IndexIDMap *>(base))
+        base = idMap->index;
+
+    d = base->d;
+    embeddings.resize(static_cast<int>(base->ntotal * d));
+    base->reconstruct_n(0, base->ntotal, embeddings.data());
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "segment", "Flat segment file used as data set.", "path" });
+    parser.addOption({ "n", "Number of random vectors.", "count", "20000" });
+    parser.addOption({ "d", "Dimension of random vectors.", "dim", "1024" });
+    parser.addOption({ "q", "Number of queries.", "count", "200" });
+    parser.addOption({ "k", "Top k.", "k", "10" });
+    parser.addOption({ "refine", "Refine k factor.", "factor", "4" });
+    parser.process(app);
+
+    int d = parser.value("d").toInt();
+    const int nq = parser.value("q").toInt();
+    const int k = parser.value("k").toInt();
+    const int refineFactor = parser.value("refine").toInt();
+
+    QVector<float> embeddings;
+    if (parser.isSet("segment")) {
+        loadSegment(parser.value("segment"), d, embeddings);
+    } else {
+        const int n = parser.value("n").toInt();
+        embeddings.resize(n * d);
+        faiss::float_rand(embeddings.data(), static_cast<size_t>(embeddings.size()), 1234);
+    }
+
+    const faiss::idx_t n = embeddings.size() / d;
+    if (n < 1 || nq < 1 || k < 1) {
+        std::cerr << "empty data set" << std::endl;
+        return 1;
+    }
+
+    QVector<float> queries(nq * d);
+    faiss::float_rand(queries.data(), static_cast<size_t>(queries.size()), 4321);
+    for (int q = 0; q < nq; q++) {
+        const float *src = embeddings.constData() + (q * n / nq) * d;
+        for (int j = 0; j < d; j++)
+            queries[q * d + j] = src[j] + (queries[q * d + j] - 0.5f) * 0.01f;
+    }
+
+    // 第一个格式 Flat 为精确结果基线
+    QVector<faiss::idx_t> exactI;
+
+    std::cout << "vectors: " << n << " dim: " << d << " queries: " << nq << " k: " << k << std::endl;
+    std::cout << "storage\t\tbytes/vector\tlatency(ms/query)\trecall@" << k << std::endl;
+
+    const QStringList factories { "Flat", "SQfp16", "SQ8", "SQfp16,RFlat", "SQ8,RFlat" };
+    for (const QString &factory : factories) {
+        QScopedPointer<faiss::Index> index(faiss::index_factory(d, factory.toStdString().c_str()));
+        if (auto refine = dynamic_cast<faiss::IndexRefine *>(index.data()))
+            refine->k_factor = refineFactor;
+        if (!index->is_trained)
+            index->train(n, embeddings.constData());
+        index->add(n, embeddings.constData());
+
+        QVector<float> D(nq * k);
+        QVector<faiss::idx_t> I(nq * k);
+        QElapsedTimer timer;
+        timer.start();
+        // 与服务端一致，逐条查询
+        for (int q = 0; q < nq; q++)
+            index->search(1, queries.constData() + q * d, k, D.data() + q * k, I.data() + q * k);
+        const double latency = static_cast<double>(timer.nsecsElapsed()) / 1e6 / nq;
+
+        if (exactI.isEmpty())
+            exactI = I;
+
+        int hits = 0;
+        for (int q = 0; q < nq; q++) {
+            QSet<faiss::idx_t> exact;
+            for (int j = 0; j < k; j++)
+                exact.insert(exactI[q * k + j]);
+            for (int j = 0; j < k; j++)
+                hits += exact.contains(I[q * k + j]) ? 1 : 0;
+        }
+
+        size_t bytes = index->sa_code_size();
+        if (auto refine = dynamic_cast<faiss::IndexRefine *>(index.data()))
+            bytes = refine->base_index->sa_code_size() + refine->refine_index->sa_code_size();
+
+        std::cout << factory.toStdString() << "\t\t" << bytes << "\t\t" << latency << "\t\t\t"
+                  << static_cast<double>(hits) / (nq * k) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "index/vectorindex/textchunker.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+
+#include <iostream>
+
+// 用法：textchunker-benchmark [--size 50] [--file a.txt --file b.txt]
+// 未指定文件时生成中文与英文两份语料(各 --size MB)，对比原 textsSpliter 与 TextChunker 的结果和耗时
+
+// 原 Embedding::textsSplitSize
+static void textsSplitSize(const QString &text, QStringList &splits, QString &over, int pos = 0)
+{
+    if (pos >= text.length()) {
+        return;
+    }
+
+    QString part = text.mid(pos, kMaxChunksSize);
+
+    if (part.length() < kMaxChunksSize) {
+        over += part;
+        return;
+    }
+    splits << part;
+    textsSplitSize(text, splits, over, pos + kMaxChunksSize);
+}
+
+// 原 Embedding::textsSpliter
+static QStringList textsSpliter(QString &texts)
+{
+    QStringList chunks;
+    QStringList splitTexts;
+
+    QRegularExpression regexSplit("[\n，；。,.]");
+    QRegularExpression regexInvalidChar("[\\s\u200B]+");
+    texts.replace(regexInvalidChar, " ");
+    texts.replace("'", "\"");
+
+    splitTexts = texts.split(regexSplit, QString::SplitBehavior::SkipEmptyParts);
+
+    QString over = "";
+    for (auto text : splitTexts) {
+        text = over + text;
+        over = "";
+
+        if (text.length() > kMaxChunksSize) {
+            textsSplitSize(text, chunks, over);
+        } else if (text.length() > kMinChunksSize && text.length() < kMaxChunksSize) {
+            chunks << text;
+        } else {
+            over = text;
+        }
+    }
+
+    if (over.length() > kMinChunksSize)
+        chunks << over;
+    else {
+        if (chunks.isEmpty())
+            chunks << over;
+        else
+            chunks.last() += over;
+    }
+
+    return chunks;
+}
+
+static QString makeCorpus(bool chinese, int bytes)
+{
+    static const QStringList zh { "向量", "索引", "文档", "检索", "模型", "服务", "分块", "中文",
+                                  "测试", "数据", "系统", "用户", "文件", "内容" };
+    static const QStringList en { "vector", "index", "document", "search", "model", "service",
+                                  "chunk", "english", "test", "data", "system", "user", "file" };
+    static const QStringList zhPunct { "，", "。", "；", "\n", " ", "" };
+    static const QStringList enPunct { ", ", ". ", "\n", "\t", " ", "'" };
+
+    QRandomGenerator gen(chinese ? 1 : 2);
+    const QStringList &words = chinese ? zh : en;
+    const QStringList &punct = chinese ? zhPunct : enPunct;
+
+    QString text;
+    text.reserve(bytes / (chinese ? 3 : 1));
+    int size = 0;
+    while (size < bytes) {
+        QString block;
+        for (int i = 0; i < 4096; i++) {
+            block += words.at(static_cast<int>(gen.bounded(words.size())));
+            if (gen.bounded(8) == 0)
+                block += punct.at(static_cast<int>(gen.bounded(punct.size())));
+            else if (!chinese)
+                block += ' ';
+        }
+        size += block.toUtf8().size();
+        text += block;
+    }
+    return text;
+}
+
+static bool run(const QString &name, const QString &corpus)
+{
+    QString copy = corpus;
+    QElapsedTimer timer;
+    timer.start();
+    QStringList expected = textsSpliter(copy);
+    const qint64 legacyMs = timer.elapsed();
+
+    timer.restart();
+    TextChunker chunker;
+    chunker.append(corpus);
+    chunker.finish();
+    QStringList actual = chunker.chunks();
+    const qint64 chunkerMs = timer.elapsed();
+
+    const bool same = expected == actual;
+    std::cout << name.toStdString() << ": " << corpus.size() << " chars, " << actual.size() << " chunks, "
+              << "textsSpliter " << legacyMs << " ms, TextChunker " << chunkerMs << " ms, "
+              << (same ? "identical" : "DIFFERENT") << std::endl;
+    return same;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({ "size", "Generated corpus size.", "MB", "50" });
+    parser.addOption({ "file", "UTF-8 text file used as corpus.", "path" });
+    parser.process(app);
+
+    bool ok = true;
+    if (parser.isSet("file")) {
+        for (const QString &path : parser.values("file")) {
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                std::cerr << "can not open " << path.toStdString() << std::endl;
+                return 1;
+            }
+            ok = run(path, QString::fromUtf8(file.readAll())) && ok;
+        }
+    } else {
+        const int bytes = parser.value("size").toInt() * 1024 * 1024;
+        ok = run("chinese", makeCorpus(true, bytes)) && ok;
+        ok = run("english", makeCorpus(false, bytes)) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -20,6 +20,41 @@
 #define SEMANTIC_ANALYSIS_GROUP "SemanticAnalysis"
 #define ENABLE_SEMANTIC_ANALYSIS "EnableSemanticAnalysis"
 
+#define VECTOR_INDEX_GROUP "VectorIndex"
+#define VECTOR_INDEX_SEGMENT_CACHE_BUDGET "SegmentCacheBudget"   // MB
+#define VECTOR_INDEX_COMPACT_SEGMENT_COUNT "CompactSegmentCount"
+#define VECTOR_INDEX_COMPACT_TOMBSTONE_RATIO "CompactTombstoneRatio"
+#define VECTOR_INDEX_COMPACT_SEGMENT_SIZE "CompactSegmentSize"
+#define VECTOR_INDEX_IVF_THRESHOLD "IvfThreshold"
+#define VECTOR_INDEX_IVF_TYPE "IvfType"
+#define VECTOR_INDEX_IVF_MIN_RECALL "IvfMinRecall"
+#define VECTOR_INDEX_NPROBE "NProbe"   // <appID>.NProbe
+#define VECTOR_INDEX_METRIC "Metric"   // <appID>.Metric: L2 / IP
+#define VECTOR_INDEX_MIN_SCORE "MinScore"   // <appID>.MinScore，仅 IP 度量生效
+#define VECTOR_INDEX_STORAGE "Storage"   // 热数据段存储格式：Flat / SQ8 / SQfp16
+#define VECTOR_INDEX_REFINE_FACTOR "RefineFactor"   // 量化段精排候选倍数，0 不精排
+#define VECTOR_INDEX_QUERY_CACHE_SIZE "QueryCacheSize"   // 查询向量缓存条目数
+#define VECTOR_INDEX_QUERY_CACHE_PERSIST "QueryCachePersist"
+#define VECTOR_INDEX_CHUNK_CACHE_SIZE "ChunkCacheSize"   // 文本块向量缓存条目数，0 关闭
+#define VECTOR_INDEX_INGEST_QUEUE_SIZE "IngestQueueSize"
+#define VECTOR_INDEX_INGEST_PARSE_THREADS "IngestParseThreads"
+#define VECTOR_INDEX_INGEST_EMBED_CONCURRENCY "IngestEmbedConcurrency"
+#define VECTOR_INDEX_INGEST_MAX_YIELD "IngestMaxYield"   // ms，批量入库为检索让出的单次最长等待，0 不让出
+#define VECTOR_INDEX_EMBED_MAX_CHARS "EmbedMaxChars"   // 单次向量化请求的字符预算上限
+#define VECTOR_INDEX_EMBED_MAX_ITEMS "EmbedMaxItems"
+#define VECTOR_INDEX_EMBED_TARGET_LATENCY "EmbedTargetLatency"   // ms，超过即缩小批次
+#define VECTOR_INDEX_EMBED_MAX_IN_FLIGHT "EmbedMaxInFlight"   // 进程内同时在途的向量化请求数
+#define VECTOR_INDEX_EMBED_WIRE_FORMAT "EmbedWireFormat"   // auto / float / base64 / binary / fp16
+#define VECTOR_INDEX_EMBED_BACKEND "EmbedBackend"   // modelhub / onnx / stub
+#define VECTOR_INDEX_EMBED_MODEL_PATH "EmbedModelPath"   // onnx 模型目录
+#define VECTOR_INDEX_EMBED_THREADS "EmbedThreads"   // 进程内推理的算子线程数，0 取核数的一半
+#define VECTOR_INDEX_CHUNK_OVERLAP "ChunkOverlap"   // 相邻文本块重叠的字符数
+#define VECTOR_INDEX_CHUNK_DELIMITERS "ChunkDelimiters"   // 断句字符
+#define VECTOR_INDEX_DOCUMENT_TOP_M "DocumentTopM"   // 两阶段检索每个查询选取的文档数，0 关闭
+#define VECTOR_INDEX_DOCUMENT_MIN_COUNT "DocumentMinCount"   // 文档数超过该值才启用两阶段检索
+#define VECTOR_INDEX_WATCH_DEBOUNCE "WatchDebounce"   // ms，文件变更事件合并的防抖窗口
+#define VECTOR_INDEX_DOCUMENT_RECALL_SAMPLE "DocumentRecallSample"   // 每 N 次两阶段检索与全量检索对比一次召回，0 关闭
+
 #define ConfigManagerIns ConfigManager::instance()
 
 class ConfigManagerPrivate;
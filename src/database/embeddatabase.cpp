@@ -5,6 +5,7 @@
 #include "embeddatabase.h"
 
 #include <QTimer>
+#include <QUrl>
 #include <QDebug>
 
 EmbedDBVendor *EmbedDBVendor::instance()
@@ -13,12 +14,18 @@ EmbedDBVendor *EmbedDBVendor::instance()
     return &ins;
 }
 
-QSqlDatabase EmbedDBVendor::addDatabase(const QString &databasePath)
+QSqlDatabase EmbedDBVendor::addDatabase(const QString &databasePath, bool readOnly)
 {
     //打开数据库
     //QString databasePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QDir::separator() +  databaseName;
     auto db = QSqlDatabase::addDatabase("QSQLITE", QUuid::createUuid().toString());
-    db.setDatabaseName(databasePath);
+    if (readOnly) {
+        // 随包安装的只读数据库：immutable 跳过文件锁与变更检测
+        db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_OPEN_URI");
+        db.setDatabaseName(QUrl::fromLocalFile(databasePath).toString(QUrl::FullyEncoded) + "?immutable=1");
+    } else {
+        db.setDatabaseName(databasePath);
+    }
     return db;
 }
 
@@ -103,6 +110,45 @@ bool EmbedDBVendor::commitTransaction(QSqlDatabase *db, const QStringList &query
     return ret;
 }
 
+bool EmbedDBVendor::commitPrepared(QSqlDatabase *db, const QString &queryStr, const QList<QVariantList> &bindValues)
+{
+    // 同一语句按行绑定参数执行，可写入 BLOB 等无法拼接的值
+    bool ret = true;
+
+    if (!openDB(db))
+        return false;
+
+    QSqlQuery query(*db);
+    if (query.exec("BEGIN TRANSACTION")) {
+        if (query.prepare(queryStr)) {
+            for (const QVariantList &values : bindValues) {
+                for (const QVariant &value : values)
+                    query.addBindValue(value);
+
+                if (!query.exec()) {
+                    qWarning() << "Error executing query:" << query.lastError().text();
+                    ret = false;
+                    break;
+                }
+            }
+        } else {
+            qWarning() << "Error preparing query:" << query.lastError().text();
+            ret = false;
+        }
+
+        if (!query.exec(ret ? "COMMIT" : "ROLLBACK")) {
+            qWarning() << "Failed to commit transaction" << db->databaseName();
+            ret = false;
+        }
+    } else {
+        qWarning() << "Failed to begin transaction" << db->databaseName();
+        ret = false;
+    }
+
+    closeDB(db);
+    return ret;
+}
+
 bool EmbedDBVendor::isEmbedDataTableExists(QSqlDatabase *db, const QString &tableName)
 {
     bool ret = false;
@@ -16,11 +16,12 @@ class EmbedDBVendor
 {
 public:
     static EmbedDBVendor *instance();
-    QSqlDatabase addDatabase(const QString &databasePath);
+    QSqlDatabase addDatabase(const QString &databasePath, bool readOnly = false);
     void removeDatabase(QSqlDatabase *db);
     bool executeQuery(QSqlDatabase *db, const QString &queryStr, QList<QVariantList> &result);
     bool executeQuery(QSqlDatabase *db, const QString &queryStr);
     bool commitTransaction(QSqlDatabase *db, const QStringList &queryList);
+    bool commitPrepared(QSqlDatabase *db, const QString &queryStr, const QList<QVariantList> &bindValues);
     bool isEmbedDataTableExists(QSqlDatabase *db, const QString &tableName);
 protected:
     bool openDB(QSqlDatabase *db);
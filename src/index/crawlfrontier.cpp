@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "crawlfrontier.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+static constexpr int kCheckpointVersion { 1 };
+static constexpr int kCheckpointInterval { 60 * 1000 };   // ms
+
+CrawlFrontier::CrawlFrontier(const QString &checkpointFile)
+    : checkpointFile(checkpointFile)
+{
+}
+
+bool CrawlFrontier::hasCheckpoint() const
+{
+    return QFile::exists(checkpointFile);
+}
+
+bool CrawlFrontier::begin(const QString &root)
+{
+    QMutexLocker lk(&mtx);
+    this->root = root;
+    pending.clear();
+    current.clear();
+    seen = indexed = completedDirs = 0;
+    resumed = false;
+    active = true;
+    lastSave.start();
+
+    QFile file(checkpointFile);
+    if (file.open(QIODevice::ReadOnly)) {
+        const QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+        // 根目录变化或版本不符时重新扫描
+        if (obj.value("version").toInt() == kCheckpointVersion && obj.value("root").toString() == root) {
+            for (const QJsonValue &dir : obj.value("pending").toArray())
+                pending << dir.toString();
+            seen = obj.value("seen").toVariant().toLongLong();
+            indexed = obj.value("indexed").toVariant().toLongLong();
+            completedDirs = obj.value("completedDirs").toVariant().toLongLong();
+            resumed = true;
+            qInfo() << "resume crawl from" << checkpointFile << "pending dirs" << pending.size();
+        }
+    }
+
+    if (!resumed)
+        pending << root;
+    return resumed;
+}
+
+bool CrawlFrontier::walk(const Visitor &visit, const Flusher &flush, const Running &running)
+{
+    forever {
+        {
+            QMutexLocker lk(&mtx);
+            if (pending.isEmpty())
+                return true;
+        }
+
+        if (!running())
+            break;
+
+        // 在目录边界写断点，断点之前访问的文件先落盘
+        if (lastSave.elapsed() >= kCheckpointInterval) {
+            if (flush)
+                flush();
+            save();
+            lastSave.restart();
+        }
+
+        QString dir;
+        {
+            QMutexLocker lk(&mtx);
+            dir = pending.takeLast();
+            current = dir;
+            currentSeen = seen;
+            currentIndexed = indexed;
+        }
+
+        // 子目录在当前目录扫描完成后才加入前沿，中途停止时断点中不会与重新列出的当前目录重复
+        QStringList children;
+        visitDir(dir, visit, running, children);
+        if (!running())
+            break;
+
+        QMutexLocker lk(&mtx);
+        pending << children;
+        current.clear();
+        completedDirs++;
+    }
+
+    // 中途停止，保存断点
+    if (flush)
+        flush();
+    save();
+    return false;
+}
+
+void CrawlFrontier::end(bool discard)
+{
+    QMutexLocker lk(&mtx);
+    active = false;
+    if (discard || (pending.isEmpty() && current.isEmpty()))
+        QFile::remove(checkpointFile);
+}
+
+QVariantHash CrawlFrontier::progress() const
+{
+    QMutexLocker lk(&mtx);
+    QVariantHash hash;
+    hash.insert("active", active);
+    hash.insert("resumed", resumed);
+    hash.insert("seen", seen);
+    hash.insert("indexed", indexed);
+    hash.insert("completedDirs", completedDirs);
+    hash.insert("remainingDirs", pending.size() + (current.isEmpty() ? 0 : 1));
+    return hash;
+}
+
+bool CrawlFrontier::save()
+{
+    QJsonObject obj;
+    {
+        QMutexLocker lk(&mtx);
+        // 正在扫描的目录恢复后重新列出，计数回退到开始扫描它之前
+        QStringList dirs = pending;
+        if (!current.isEmpty())
+            dirs << current;
+
+        obj.insert("version", kCheckpointVersion);
+        obj.insert("root", root);
+        obj.insert("pending", QJsonArray::fromStringList(dirs));
+        obj.insert("seen", current.isEmpty() ? seen : currentSeen);
+        obj.insert("indexed", current.isEmpty() ? indexed : currentIndexed);
+        obj.insert("completedDirs", completedDirs);
+    }
+
+    QDir().mkpath(QFileInfo(checkpointFile).absolutePath());
+    QSaveFile file(checkpointFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "can not write crawl checkpoint:" << checkpointFile;
+        return false;
+    }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+void CrawlFrontier::visitDir(const QString &dir, const Visitor &visit, const Running &running,
+                             QStringList &children)
+{
+    DIR *handle = opendir(QFile::encodeName(dir).constData());
+    if (!handle) {
+        qWarning() << "can not open: " << dir;
+        return;
+    }
+
+    QString prefix = dir;
+    if (prefix != "/")
+        prefix += '/';
+
+    struct dirent *dent = nullptr;
+    while ((dent = readdir(handle)) && running()) {
+        if (dent->d_name[0] == '.')
+            continue;
+
+        const QString path = prefix + QFile::decodeName(dent->d_name);
+        struct stat st;
+        if (stat(QFile::encodeName(path).constData(), &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (visit(path, true))
+                children << path;
+            continue;
+        }
+
+        const bool ok = visit(path, false);
+        QMutexLocker lk(&mtx);
+        seen++;
+        if (ok)
+            indexed++;
+    }
+
+    closedir(handle);
+}
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef CRAWLFRONTIER_H
+#define CRAWLFRONTIER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QStringList>
+#include <QVariantHash>
+
+#include <functional>
+
+// 可断点续扫的目录遍历：待扫描目录(前沿)为栈，不在栈中的目录即已扫描完成
+// 定期将前沿与计数写入断点文件，重启后从断点继续；正在扫描的目录在断点中仍为待扫描，恢复后重新列出
+class CrawlFrontier
+{
+public:
+    // 返回 false 不进入该目录 / 文件未建索引
+    typedef std::function<bool(const QString &path, bool isDir)> Visitor;
+    // 写断点前调用，使已访问文件的索引落盘
+    typedef std::function<void()> Flusher;
+    typedef std::function<bool()> Running;
+
+    explicit CrawlFrontier(const QString &checkpointFile);
+
+    bool hasCheckpoint() const;
+    // 有断点时从断点恢复，否则从 root 开始；返回是否为恢复
+    bool begin(const QString &root);
+    // 遍历到前沿为空或 running 返回 false；返回是否完成
+    bool walk(const Visitor &visit, const Flusher &flush, const Running &running);
+    // 中途停止时保留断点以便继续，discard 为 true 时丢弃
+    void end(bool discard = false);
+
+    QVariantHash progress() const;
+
+private:
+    bool save();
+    void visitDir(const QString &dir, const Visitor &visit, const Running &running, QStringList &children);
+
+    QString checkpointFile;
+
+    mutable QMutex mtx;
+    QString root;
+    QStringList pending;
+    QString current;   // 正在扫描的目录
+    qint64 seen = 0;
+    qint64 indexed = 0;
+    qint64 completedDirs = 0;
+    qint64 currentSeen = 0;   // 开始扫描当前目录时的计数
+    qint64 currentIndexed = 0;
+    bool resumed = false;
+    bool active = false;
+
+    QElapsedTimer lastSave;
+};
+
+#endif // CRAWLFRONTIER_H
@@ -8,14 +8,13 @@
 #include "database/embeddatabase.h"
 #include "global_define.h"
 #include "index/indexmanager.h"
+#include "vectorindex/documentreader.h"
+#include "vectorindex/lanescheduler.h"
 
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
 
-#include <dirent.h>
-#include <sys/stat.h>
-
 EmbeddingWorkerPrivate::EmbeddingWorkerPrivate(QObject *parent)
     : QObject(parent)
 {
@@ -44,16 +43,27 @@ void EmbeddingWorkerPrivate::init()
     indexer = new VectorIndex(&dataBase, &dbMtx, appID, this);
 
     QString databasePath;
-    if (appID == kSystemAssistantKey)
+    bool readOnly = false;
+    if (appID == kSystemAssistantKey) {
         databasePath = QString("%0.db").arg(kSystemAssistantData);
-    else
+        readOnly = true;
+    } else {
         databasePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QDir::separator() +  appID + ".db";;
-    dataBase = EmbedDBVendorIns->addDatabase(databasePath);
+    }
+    dataBase = EmbedDBVendorIns->addDatabase(databasePath, readOnly);
+
+    // 检索读元数据使用单独的连接，不与入库争用同一把锁；WAL 模式下读不被写事务阻塞
+    queryDataBase = EmbedDBVendorIns->addDatabase(databasePath, readOnly);
+    embedder->setQueryDatabase(&queryDataBase, &queryDbMtx);
+    if (!readOnly)
+        EmbedDBVendorIns->executeQuery(&dataBase, "PRAGMA journal_mode=WAL");
 
     if (appID == kUosAIAssistant) {
         // uos-ai 另存原文档
         m_saveAsDoc = true;
     }
+
+    crawl = new CrawlFrontier(workerDir() + QDir::separator() + appID + ".crawl");
 }
 
 bool EmbeddingWorkerPrivate::enableEmbedding(const QString &file)
@@ -91,35 +101,38 @@ QStringList EmbeddingWorkerPrivate::embeddingPaths()
 }
 
 
-int EmbeddingWorkerPrivate::updateIndex(const QStringList &files)
+int EmbeddingWorkerPrivate::updateIndex(const QStringList &files, QStringList &failed)
 {
     embedder->createEmbedDataTable();
 
     if (files.isEmpty())
         return GET_INDEX_STATUS_CODE(INDEX_STATUS_DOCERROR);
 
-    bool embedRes = true;
+    // 逐个文档处理，失败的文档不写入缓存，跳过即可，不影响同批其他文档与已缓存的数据
+    QStringList embedded;
     for (const QString &embeddingfile : files) {
-        if (m_saveAsDoc)
-            embedRes &= embedder->embeddingDocumentSaveAs(embeddingfile);
-        else
-            embedRes &= embedder->embeddingDocument(embeddingfile);
+        LaneSchedulerIns->yield();
+        bool embedRes = m_saveAsDoc ? embedder->embeddingDocumentSaveAs(embeddingfile)
+                                    : embedder->embeddingDocument(embeddingfile);
+        if (embedRes) {
+            embedded << embeddingfile;
+        } else {
+            qWarning() << "embedding failed, skip" << embeddingfile;
+            failed << embeddingfile;
+        }
     }
 
-    if (!embedRes) {
-        embedder->embeddingClear();
+    if (embedded.isEmpty())
         return GET_INDEX_STATUS_CODE(INDEX_STATUS_DOCERROR);
-    }
 
-    bool updateRes = indexer->updateIndex(EmbeddingDim, embedder->getEmbedVectorCache());
-    if (!updateRes) {
-        embedder->embeddingClear();
+    // 未加入内存索引的向量仍在缓存中，下次更新时补入
+    bool updateRes = indexer->updateIndex(EmbeddingDim, embedder->getEmbedVectorCache(), embedder->getEmbedDataCache());
+    if (!updateRes)
         return GET_INDEX_STATUS_CODE(INDEX_STATUS_DATAERROR);
-    }
 
     if (m_saveAsDoc) {
         // 复制原文档
-        for (const QString &embeddingfile : files) {
+        for (const QString &embeddingfile : embedded) {
             embedder->doSaveAsDoc(embeddingfile);
         }
     }
@@ -128,6 +141,25 @@ int EmbeddingWorkerPrivate::updateIndex(const QStringList &files)
     return GET_INDEX_STATUS_CODE(INDEX_STATUS_SUCCESS);
 }
 
+int EmbeddingWorkerPrivate::writeIngestDocument(const IngestDocument &doc)
+{
+    // 流水线的写入级，只在工作线程执行
+    LaneSchedulerIns->yield();
+    if (!embedder->appendDocument(doc))
+        return GET_INDEX_STATUS_CODE(INDEX_STATUS_DOCERROR);
+
+    if (!indexer->updateIndex(EmbeddingDim, embedder->getEmbedVectorCache(), embedder->getEmbedDataCache()))
+        return GET_INDEX_STATUS_CODE(INDEX_STATUS_DATAERROR);
+
+    if (m_saveAsDoc) {
+        // 复制原文档
+        embedder->doSaveAsDoc(doc.file);
+    }
+
+    indexUpdateTime = QDateTime::currentDateTimeUtc().toSecsSinceEpoch();
+    return GET_INDEX_STATUS_CODE(INDEX_STATUS_SUCCESS);
+}
+
 bool EmbeddingWorkerPrivate::deleteIndex(const QStringList &files)
 {
     QString sourceStr = "(";
@@ -157,6 +189,7 @@ bool EmbeddingWorkerPrivate::deleteIndex(const QStringList &files)
 
     // 索引deleteBitSet置1
     QString idsStr = "(";
+    QVector<faiss::idx_t> deletedIDs;
     for (const QVariantList &res : result) {
         if (res.empty())
             break;
@@ -165,18 +198,23 @@ bool EmbeddingWorkerPrivate::deleteIndex(const QStringList &files)
             continue;
 
         faiss::idx_t id = res[0].toInt();
+        deletedIDs << id;
         if (result.last() == res) {
             idsStr += "'" + QString::number(id) + "')";
             break;
         }
         idsStr += "'" + QString::number(id) + "', ";
     }
-    QString updateBitSet = "UPDATE " + QString(kEmbeddingDBIndexSegTable) + " SET " + QString(kEmbeddingDBSegIndexTableBitSet)
-                           + " = '" + QString::number(1) + "' WHERE id IN " + idsStr;
-    {
+    // 只在缓存中的文档没有落盘数据需要标记
+    if (!deletedIDs.isEmpty()) {
+        QString updateBitSet = "UPDATE " + QString(kEmbeddingDBIndexSegTable) + " SET " + QString(kEmbeddingDBSegIndexTableBitSet)
+                               + " = '" + QString::number(1) + "' WHERE id IN " + idsStr;
         QMutexLocker lk(&dbMtx);
         EmbedDBVendorIns->executeQuery(&dataBase, updateBitSet);
     }
+    // 同步常驻的删除标记，检索无需再查段表
+    indexer->markDeleted(deletedIDs);
+    indexer->removeDocuments(files);
 
     // 删除另存的文档
     if (m_saveAsDoc)
@@ -187,16 +225,39 @@ bool EmbeddingWorkerPrivate::deleteIndex(const QStringList &files)
 
 QString EmbeddingWorkerPrivate::vectorSearch(const QString &query, int topK)
 {
+    LaneScheduler::QueryScope lane;
+
     QVector<float> queryVector;  //查询向量 传递float指针
     embedder->embeddingQuery(query, queryVector);
 
-    QMap<float, faiss::idx_t> cacheSearchRes;
-    QMap<float, faiss::idx_t> dumpSearchRes;
-    indexer->vectorSearch(topK, queryVector.data(), cacheSearchRes, dumpSearchRes);
-    QString res = embedder->loadTextsFromSearch(topK, cacheSearchRes, dumpSearchRes);
+    if (queryVector.size() != EmbeddingDim)
+        return {};
+
+    QVector<SearchResult> searchResults = indexer->vectorSearch(topK, queryVector.data());
+    QString res = embedder->loadTextsFromSearch(topK, searchResults);
     return res;
 }
 
+QString EmbeddingWorkerPrivate::vectorSearchBatch(const QStringList &queries, int topK)
+{
+    LaneScheduler::QueryScope lane;
+
+    QVector<QVector<float>> queryVectors = embedder->embeddingQueries(queries);
+    if (queryVectors.size() != queries.size())
+        return {};
+
+    QVector<float> queryData;
+    queryData.reserve(queries.size() * EmbeddingDim);
+    for (const QVector<float> &queryVector : queryVectors) {
+        if (queryVector.size() != EmbeddingDim)
+            return {};
+        queryData += queryVector;
+    }
+
+    QVector<QVector<SearchResult>> searchResults = indexer->vectorSearch(queries.size(), topK, queryData.constData());
+    return embedder->loadTextsFromSearch(topK, searchResults);
+}
+
 QString EmbeddingWorkerPrivate::indexDir()
 {
     return workerDir() + QDir::separator() + appID;
@@ -289,6 +350,18 @@ EmbeddingWorker::EmbeddingWorker(const QString &appid, QObject *parent)
     d->appID = appid;
     d->init();
 
+    d->pipeline = new IngestPipeline(d->embedder, d->m_saveAsDoc, [this](const IngestDocument &doc) {
+        int ret = d->writeIngestDocument(doc);
+        Q_EMIT statusChanged(d->appID, {doc.file}, ret);
+    });
+
+    // 文件监视事件合并后批量处理，随工作对象移入工作线程
+    d->fileEvents = new FileEventQueue([this](const QString &file) {
+        return d->isSupportDoc(file);
+    }, [this](const QStringList &created, const QStringList &deleted) {
+        doFileEvents(created, deleted);
+    }, this);
+
     moveToThread(&d->workThread);
     d->workThread.start();
 
@@ -300,13 +373,29 @@ EmbeddingWorker::EmbeddingWorker(const QString &appid, QObject *parent)
     connect(&dumpTimer, &QTimer::timeout, this, &EmbeddingWorker::doIndexDump);
     dumpTimer.start(10000);
 
+    compactTimer.setInterval(5 * 60 * 1000); // 5分钟检查一次段合并
+    compactTimer.setSingleShot(false);
+    connect(&compactTimer, &QTimer::timeout, this, &EmbeddingWorker::doIndexCompact);
+    compactTimer.start();
+
     //索引建立成功，完成后续操作
     //connect(this, &EmbeddingWorker::indexCreateSuccess, d->embedder, &Embedding::onIndexCreateSuccess);
 }
 
 EmbeddingWorker::~EmbeddingWorker()
 {
-    // 已建索引落盘、数据存储
+    // 先停下工作线程：全量遍历退出时保存断点(不丢弃)，流水线与断点只能在其停止后释放
+    d->m_creatingAll = false;
+    if (QThread::currentThread() != &d->workThread) {
+        d->workThread.quit();
+        d->workThread.wait();
+    }
+
+    // 停止批量入库，已建索引落盘、数据存储
+    if (d->pipeline) {
+        delete d->pipeline;
+        d->pipeline = nullptr;
+    }
     doIndexDump();
 
     if (d->embedder) {
@@ -319,7 +408,11 @@ EmbeddingWorker::~EmbeddingWorker()
         d->indexer = nullptr;
     }
 
+    delete d->crawl;
+    d->crawl = nullptr;
+
     EmbedDBVendor::instance()->removeDatabase(&d->dataBase);
+    EmbedDBVendor::instance()->removeDatabase(&d->queryDataBase);
 
     //TODO:停止embeddding、已建索引落盘、数据存储等
 }
@@ -331,6 +424,7 @@ void EmbeddingWorker::setEmbeddingApi(embeddingApi api, void *user)
 
 void EmbeddingWorker::stop()
 {
+    d->crawlDiscard = true;
     d->m_creatingAll = false;
     Q_EMIT stopEmbedding();
 }
@@ -345,15 +439,33 @@ int EmbeddingWorker::createAllState()
     return  d->m_creatingAll ? GET_INDEX_STATUS_CODE(INDEX_STATUS_CREATING) : GET_INDEX_STATUS_CODE(INDEX_STATUS_SUCCESS);
 }
 
+bool EmbeddingWorker::hasCrawlCheckpoint()
+{
+    return d->crawl->hasCheckpoint();
+}
+
+QVariantHash EmbeddingWorker::crawlProgress()
+{
+    return d->crawl->progress();
+}
+
 void EmbeddingWorker::setWatch(bool watch)
 {
     auto idx = IndexManager::instance();
     Q_ASSERT(idx);
     disconnect(idx, nullptr, this, nullptr);
     if (watch) {
-        connect(idx, &IndexManager::fileCreated, this, &EmbeddingWorker::onFileMonitorCreate);
-        connect(idx, &IndexManager::fileDeleted, this, &EmbeddingWorker::onFileMonitorDelete);
+        // 在监视线程直接入队，由队列过滤与合并
+        FileEventQueue *events = d->fileEvents;
+        connect(idx, &IndexManager::fileCreated, this, [events](const QString &file) {
+            events->pushCreated(file);
+        }, Qt::DirectConnection);
+        connect(idx, &IndexManager::fileDeleted, this, [events](const QString &file) {
+            events->pushDeleted(file);
+        }, Qt::DirectConnection);
         //connect(idx, &IndexManager::fileAttributeChanged, this, );
+    } else {
+        d->fileEvents->clear();
     }
 }
 
@@ -362,6 +474,13 @@ qint64 EmbeddingWorker::getIndexUpdateTime()
     return d->indexUpdateTime;
 }
 
+QVariantHash EmbeddingWorker::ingestStats()
+{
+    QVariantHash hash = d->pipeline->stats();
+    hash.insert("watch", d->fileEvents->stats());
+    return hash;
+}
+
 bool EmbeddingWorker::doCreateIndex(const QStringList &files)
 {
     //过滤文档
@@ -372,9 +491,7 @@ bool EmbeddingWorker::doCreateIndex(const QStringList &files)
         }
     }
 
-    int ret = d->updateIndex(files);
-    Q_EMIT statusChanged(d->appID, files, ret);
-
+    updateFiles(files);
     return true;
 }
 
@@ -396,14 +513,54 @@ bool EmbeddingWorker::doDeleteIndex(const QStringList &files)
     return ret;
 }
 
-void EmbeddingWorker::onFileMonitorCreate(const QString &file)
+void EmbeddingWorker::doFileEvents(const QStringList &created, const QStringList &deleted)
 {
-    doCreateIndex(QStringList(file));
+    // 只删除已建索引的文档；新建的文件可能覆盖了已建索引的同名文件(先写临时文件再重命名)，删除旧索引后重建
+    auto indexed = [this](const QString &file) {
+        return d->embedder->isCacheDocument(file) || d->embedder->isDupDocument(file);
+    };
+
+    QStringList removed;
+    QStringList deletedIndexed;
+    for (const QString &file : deleted) {
+        if (indexed(file))
+            deletedIndexed << file;
+    }
+    removed << deletedIndexed;
+
+    QStringList existing;
+    for (const QString &file : created) {
+        if (!QFileInfo::exists(file))
+            continue;
+        existing << file;
+        if (indexed(file))
+            removed << file;
+    }
+
+    if (!removed.isEmpty() && d->deleteIndex(removed) && !deletedIndexed.isEmpty())
+        Q_EMIT indexDeleted(d->appID, deletedIndexed);
+
+    if (existing.isEmpty())
+        return;
+
+    updateFiles(existing);
 }
 
-void EmbeddingWorker::onFileMonitorDelete(const QString &file)
+void EmbeddingWorker::updateFiles(const QStringList &files)
 {
-    doDeleteIndex(QStringList(file));
+    // 失败的文档单独上报，其余文档的状态取决于内存索引是否更新成功
+    QStringList failed;
+    int ret = d->updateIndex(files, failed);
+    if (!failed.isEmpty())
+        Q_EMIT statusChanged(d->appID, failed, GET_INDEX_STATUS_CODE(INDEX_STATUS_DOCERROR));
+
+    QStringList embedded;
+    for (const QString &file : files) {
+        if (!failed.contains(file))
+            embedded << file;
+    }
+    if (!embedded.isEmpty())
+        Q_EMIT statusChanged(d->appID, embedded, ret);
 }
 
 void EmbeddingWorker::doIndexDump()
@@ -414,67 +571,69 @@ void EmbeddingWorker::doIndexDump()
     if (startID > endID)
         return;
 
+    LaneSchedulerIns->yield();
     if (d->embedder->doIndexDump(startID, endID)) {
         d->indexer->doIndexDump();
+        // 落盘后异步检查段合并，不阻塞当前落盘流程
+        QMetaObject::invokeMethod(this, "doIndexCompact", Qt::QueuedConnection);
     }
 }
 
-void EmbeddingWorker::onCreateAllIndex()
+void EmbeddingWorker::doIndexCompact()
 {
-    d->m_creatingAll = true;
-    QString path = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
-    traverseAndCreate(path);
-    d->m_creatingAll = false;
-}
-
-void EmbeddingWorker::traverseAndCreate(const QString &path)
-{
-    if (!d->m_creatingAll || d->isFilter(path))
-        return;
+    LaneSchedulerIns->yield();
 
-    const std::string tmp = path.toStdString();
-    const char *filePath = tmp.c_str();
-    struct stat st;
-    if (stat(filePath, &st) != 0)
-        return;
+    // 文档级索引缺失时由落盘段重建
+    d->indexer->rebuildDocumentIndex();
 
-    if (S_ISDIR(st.st_mode)) {
-        DIR *dir = nullptr;
-        if (!(dir = opendir(filePath))) {
-            qWarning() << "can not open: " << filePath;
-            return;
-        }
+    if (d->indexer->needCompact())
+        d->indexer->doIndexCompact();
 
-        struct dirent *dent = nullptr;
-        char fn[FILENAME_MAX] = { 0 };
-        strcpy(fn, filePath);
-        size_t len = strlen(filePath);
-        if (strcmp(filePath, "/"))
-            fn[len++] = '/';
+    // 落盘数据达到阈值后转入 IVF 冷数据层
+    d->indexer->doIvfTier();
+}
 
-        // traverse
-        while ((dent = readdir(dir)) && d->m_creatingAll) {
-            if (dent->d_name[0] == '.')
-                continue;
+void EmbeddingWorker::onCreateAllIndex()
+{
+    d->m_creatingAll = true;
+    d->crawlDiscard = false;
+    QString path = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
 
-            if (!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, ".."))
-                continue;
+    // 有断点时从断点继续，已扫描完成的目录不再遍历
+    d->crawl->begin(path);
+    d->crawl->walk([this](const QString &file, bool isDir) {
+        if (d->isFilter(file))
+            return false;
+        return isDir || crawlFile(file);
+    }, [this]() {
+        // 断点之前提交的文档全部入库并落盘，重启后才不会遗漏
+        d->pipeline->finish();
+        doIndexDump();
+    }, [this]() {
+        return d->m_creatingAll.load();
+    });
 
-            strncpy(fn + len, dent->d_name, FILENAME_MAX - len);
-            traverseAndCreate(fn);
-        }
+    // 等待流水线中的文档全部入库
+    d->pipeline->finish();
+    d->crawl->end(d->crawlDiscard);
+    d->m_creatingAll = false;
+}
 
-        if (dir)
-            closedir(dir);
-        return;
+bool EmbeddingWorker::crawlFile(const QString &path)
+{
+    if (!d->isSupportDoc(path)) {
+        qDebug() << path << " doc not support!";
+        return false;
     }
 
+    // 纯文本流式读取，只取前100个分块时不受文件大小限制
     static const int maxFileSize = 50 * 1024 * 1024; //50MB
-    if (QFileInfo(path).size() > maxFileSize)
-        return;
+    const bool streamed = !d->m_saveAsDoc && DocumentReader::isPlainText(path);
+    if (!streamed && QFileInfo(path).size() > maxFileSize)
+        return false;
 
-    if (d->m_creatingAll)
-        doCreateIndex({path});
+    d->pipeline->submit(path);
+    return true;
 }
 
 QString EmbeddingWorker::doVectorSearch(const QString &query, int topK)
@@ -486,6 +645,15 @@ QString EmbeddingWorker::doVectorSearch(const QString &query, int topK)
     return d->vectorSearch(query,topK);
 }
 
+QString EmbeddingWorker::doVectorSearchBatch(const QStringList &queries, int topK)
+{
+    if (queries.isEmpty() || queries.contains(QString())) {
+        qWarning() << "query is empty!";
+        return {};
+    }
+    return d->vectorSearchBatch(queries, topK);
+}
+
 QString EmbeddingWorker::getDocFile()
 {
     return d->getIndexDocs();
@@ -11,6 +11,7 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QVariantHash>
 
 class EmbeddingWorkerPrivate;
 class EmbeddingWorker : public QObject
@@ -25,19 +26,22 @@ public:
 
     void saveAllIndex();
     int createAllState();
+    bool hasCrawlCheckpoint();
+    QVariantHash crawlProgress();
     void setWatch(bool watch);
     qint64 getIndexUpdateTime();
+    QVariantHash ingestStats();
 public Q_SLOTS:
     QString doVectorSearch(const QString &query, int topK);
+    QString doVectorSearchBatch(const QStringList &queries, int topK);
     QString getDocFile();
 
     void onCreateAllIndex();
     bool doCreateIndex(const QStringList &files);
     bool doDeleteIndex(const QStringList &files);
-    void onFileMonitorCreate(const QString &file);
-    void onFileMonitorDelete(const QString &file);
 private Q_SLOTS:
     void doIndexDump();
+    void doIndexCompact();
 //end
 
 signals:
@@ -47,11 +51,14 @@ signals:
 
     void stopEmbedding();
 private:
-    void traverseAndCreate(const QString &path);
+    bool crawlFile(const QString &path);
+    void updateFiles(const QStringList &files);
+    void doFileEvents(const QStringList &created, const QStringList &deleted);
 private:
     EmbeddingWorkerPrivate *d { nullptr };
 
     QTimer dumpTimer;
+    QTimer compactTimer;
 };
 
 #endif // EMBEDDINGWORKER_H
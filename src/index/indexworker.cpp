@@ -110,6 +110,25 @@ void IndexWorkerPrivate::doIndexTask(const Lucene::IndexWriterPtr &writer, const
     indexFile(writer, file, type);
 }
 
+bool IndexWorkerPrivate::crawlEntry(const IndexWriterPtr &writer, const QString &file, bool isDir, bool isCheck)
+{
+    if (isFilter(file))
+        return false;
+
+    // limit file name length and level
+    if (file.size() > FILENAME_MAX - 1 || file.count('/') > 20)
+        return false;
+
+    if (isDir)
+        return true;
+
+    IndexType type = CreateIndex;
+    if (isCheck && !checkUpdate(writer->getReader(), file, type))
+        return false;
+    indexFile(writer, file, type);
+    return true;
+}
+
 void IndexWorkerPrivate::indexFile(Lucene::IndexWriterPtr writer, const QString &file, IndexWorkerPrivate::IndexType type)
 {
     Q_ASSERT(writer);
@@ -317,12 +336,52 @@ void IndexWorker::onCreateAllIndex()
     if (d->isStoped)
         return;
 
-    if (d->indexExists()) {
+    // 上次全量索引中断时从断点继续，否则已有索引只做更新检查；索引已被删除时断点无效
+    if (!d->indexExists())
+        d->crawl.end(true);
+    const bool resume = d->crawl.hasCheckpoint();
+    if (!resume && d->indexExists()) {
         QTimer::singleShot(10 * 1000, this, &IndexWorker::onUpdateAllIndex);
         return;
     }
 
-    onFileCreated(QStandardPaths::writableLocation(QStandardPaths::HomeLocation));
+    QDir dir;
+    if (!dir.exists(d->indexStoragePath())) {
+        if (!dir.mkpath(d->indexStoragePath())) {
+            qWarning() << "Unable to create directory: " << d->indexStoragePath();
+            return;
+        }
+    }
+
+    try {
+        // record spending
+        QTime timer;
+        timer.start();
+        d->indexFileCount = 0;
+        IndexWriterPtr writer = d->newIndexWriter(!d->indexExists());
+
+        // 恢复时断点所在目录会重新列出，已建索引且未修改的文件跳过
+        d->crawl.begin(QStandardPaths::writableLocation(QStandardPaths::HomeLocation));
+        d->crawl.walk([this, &writer, resume](const QString &file, bool isDir) {
+            return d->crawlEntry(writer, file, isDir, resume);
+        }, [&writer]() {
+            writer->commit();
+        }, [this]() {
+            return !d->isStoped;
+        });
+        d->crawl.end();
+
+        writer->optimize();
+        writer->close();
+
+        qInfo() << "create all index spending: " << timer.elapsed() << d->indexFileCount << d->crawl.progress();
+    } catch (const LuceneException &e) {
+        qWarning() << QString::fromStdWString(e.getError());
+    } catch (const std::exception &e) {
+        qWarning() << QString(e.what());
+    } catch (...) {
+        qWarning() << "The file index created failed!";
+    }
 }
 
 void IndexWorker::onUpdateAllIndex()
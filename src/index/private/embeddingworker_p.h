@@ -7,6 +7,9 @@
 
 #include "../vectorindex/embedding.h"
 #include "../vectorindex/vectorindex.h"
+#include "../vectorindex/ingestpipeline.h"
+#include "../vectorindex/fileeventqueue.h"
+#include "../crawlfrontier.h"
 
 #include <QObject>
 #include <QStandardPaths>
@@ -14,6 +17,8 @@
 #include <QMutex>
 #include <QThread>
 
+#include <atomic>
+
 class EmbeddingWorkerPrivate : public QObject
 {
     Q_OBJECT
@@ -36,9 +41,12 @@ public:
     }
     QStringList embeddingPaths();
 
-    int updateIndex(const QStringList &files);
+    // 返回成功文档的状态，向量化失败的文档加入 failed
+    int updateIndex(const QStringList &files, QStringList &failed);
+    int writeIngestDocument(const IngestDocument &doc);
     bool deleteIndex(const QStringList &files);
     QString vectorSearch(const QString &query, int topK);
+    QString vectorSearchBatch(const QStringList &queries, int topK);
 
     QString indexDir();
     QString getIndexDocs();
@@ -48,8 +56,12 @@ public:
 public:
     Embedding *embedder {nullptr};
     VectorIndex *indexer {nullptr};
+    IngestPipeline *pipeline {nullptr};
+    FileEventQueue *fileEvents {nullptr};
+    CrawlFrontier *crawl {nullptr};
 
-    bool m_creatingAll = false;
+    std::atomic_bool m_creatingAll { false };   // 全量建索引期间可由其他线程停止
+    std::atomic_bool crawlDiscard { false };   // 用户关闭自动索引时丢弃断点
     bool m_saveAsDoc = false;
 
     qint64 indexUpdateTime = 0;
@@ -59,6 +71,8 @@ public:
 
     QSqlDatabase dataBase;
     QMutex dbMtx;
+    QSqlDatabase queryDataBase;   // 检索专用连接
+    QMutex queryDbMtx;
 };
 
 #endif // VECTORWORKER_P_H
@@ -6,6 +6,7 @@
 #define INDEXWORKER_P_H
 
 #include "parser/abstractpropertyparser.h"
+#include "index/crawlfrontier.h"
 
 #include <lucene++/LuceneHeaders.h>
 
@@ -41,6 +42,7 @@ public:
     }
 
     void doIndexTask(const Lucene::IndexWriterPtr &writer, const QString &file, IndexType type, bool isCheck = false);
+    bool crawlEntry(const Lucene::IndexWriterPtr &writer, const QString &file, bool isDir, bool isCheck);
     void indexFile(Lucene::IndexWriterPtr writer, const QString &file, IndexType type);
     bool checkUpdate(const Lucene::IndexReaderPtr &reader, const QString &file, IndexType &type);
     Lucene::DocumentPtr indexDocument(const QString &file);
@@ -48,6 +50,7 @@ public:
 
     QMap<QString, AbstractPropertyParser *> propertyParsers;
     quint32 indexFileCount { 0 };
+    CrawlFrontier crawl { indexStoragePath() + ".crawl" };   // 全量索引的断点
     std::atomic_bool isStoped { true };
 };
 
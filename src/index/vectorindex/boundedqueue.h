@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+// 有界阻塞队列：队列满时生产者等待，形成流水线各级之间的背压
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)
+        : capacity(qMax(1, capacity))
+    {
+    }
+
+    // 阻塞直至入队；队列已关闭时返回 false
+    bool push(const T &item)
+    {
+        QMutexLocker lk(&mtx);
+        while (!closed && queue.size() >= capacity)
+            notFull.wait(&mtx);
+
+        if (closed)
+            return false;
+
+        queue.enqueue(item);
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    bool tryPush(const T &item, unsigned long timeoutMs)
+    {
+        QMutexLocker lk(&mtx);
+        if (!closed && queue.size() >= capacity)
+            notFull.wait(&mtx, timeoutMs);
+
+        if (closed || queue.size() >= capacity)
+            return false;
+
+        queue.enqueue(item);
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    // 阻塞直至出队；队列已关闭且为空时返回 false
+    bool pop(T &item)
+    {
+        QMutexLocker lk(&mtx);
+        while (!closed && queue.isEmpty())
+            notEmpty.wait(&mtx);
+
+        if (queue.isEmpty())
+            return false;
+
+        item = queue.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    bool tryPop(T &item, unsigned long timeoutMs = 0)
+    {
+        QMutexLocker lk(&mtx);
+        if (!closed && queue.isEmpty() && timeoutMs > 0)
+            notEmpty.wait(&mtx, timeoutMs);
+
+        if (queue.isEmpty())
+            return false;
+
+        item = queue.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    // 关闭后不再接受入队，已入队的元素仍可取出
+    void close()
+    {
+        QMutexLocker lk(&mtx);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+    void reopen()
+    {
+        QMutexLocker lk(&mtx);
+        closed = false;
+    }
+
+    bool isClosed()
+    {
+        QMutexLocker lk(&mtx);
+        return closed;
+    }
+
+    bool isDrained()
+    {
+        QMutexLocker lk(&mtx);
+        return closed && queue.isEmpty();
+    }
+
+    int size()
+    {
+        QMutexLocker lk(&mtx);
+        return queue.size();
+    }
+
+private:
+    QQueue<T> queue;
+    int capacity = 1;
+    bool closed = false;
+
+    QMutex mtx;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+};
+
+#endif // BOUNDEDQUEUE_H
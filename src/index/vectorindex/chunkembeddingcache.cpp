@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "chunkembeddingcache.h"
+#include "vectorindex.h"
+#include "database/embeddatabase.h"
+#include "config/configmanager.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QHash>
+#include <QDebug>
+
+static constexpr int kDefaultChunkCacheSize { 20000 };   // 条目数，1024 维约 80MB
+static constexpr int kChunkCacheTrimInterval { 1000 };   // 每写入若干条检查一次容量
+static constexpr int kChunkCacheQueryBatch { 500 };
+static constexpr char kChunkCacheDB[] { "chunk_embedding.db" };
+static constexpr char kChunkCacheTable[] { "chunk_embedding" };
+
+namespace {
+// 线程退出时释放该线程的连接
+class ThreadConnection
+{
+public:
+    ~ThreadConnection()
+    {
+        if (!db.isValid())
+            return;
+        const QString name = db.connectionName();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+    }
+
+    QSqlDatabase db;
+};
+}
+
+ChunkEmbeddingCache *ChunkEmbeddingCache::instance()
+{
+    static ChunkEmbeddingCache ins;
+    return &ins;
+}
+
+ChunkEmbeddingCache::ChunkEmbeddingCache()
+{
+    capacity = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_CHUNK_CACHE_SIZE,
+                                       kDefaultChunkCacheSize).toInt();
+    dbPath = VectorIndex::workerDir() + QDir::separator() + kChunkCacheDB;
+}
+
+void ChunkEmbeddingCache::setModel(const QString &model)
+{
+    QMutexLocker lk(&mtx);
+    modelName = model;
+}
+
+QVector<QVector<float>> ChunkEmbeddingCache::find(const QStringList &texts)
+{
+    QVector<QVector<float>> vectors(texts.size());
+    if (capacity <= 0 || texts.isEmpty())
+        return vectors;
+
+    QString model;
+    {
+        QMutexLocker lk(&mtx);
+        if (!ensureTable())
+            return vectors;
+        model = modelName;
+    }
+
+    QHash<QString, QList<int>> keyIndexes;
+    for (int i = 0; i < texts.size(); i++)
+        keyIndexes[hashKey(model, texts[i])] << i;
+
+    QSqlDatabase *db = connection();
+    const QStringList keys = keyIndexes.keys();
+    for (int start = 0; start < keys.size(); start += kChunkCacheQueryBatch) {
+        // 键为十六进制摘要，可直接拼接
+        const QStringList batch = keys.mid(start, kChunkCacheQueryBatch);
+        QString query = "SELECT hash, vector FROM " + QString(kChunkCacheTable)
+                + " WHERE hash IN ('" + batch.join("', '") + "')";
+
+        QList<QVariantList> result;
+        EmbedDBVendorIns->executeQuery(db, query, result);
+        for (const QVariantList &res : result) {
+            if (!res[0].isValid() || !res[1].isValid())
+                continue;
+
+            const QByteArray blob = res[1].toByteArray();
+            QVector<float> vector(blob.size() / static_cast<int>(sizeof(float)));
+            memcpy(vector.data(), blob.constData(), static_cast<size_t>(vector.size()) * sizeof(float));
+            for (int index : keyIndexes.value(res[0].toString()))
+                vectors[index] = vector;
+        }
+    }
+
+    return vectors;
+}
+
+void ChunkEmbeddingCache::insert(const QStringList &texts, const QVector<QVector<float>> &vectors)
+{
+    if (texts.size() != vectors.size() || capacity <= 0 || texts.isEmpty())
+        return;
+
+    QString model;
+    {
+        QMutexLocker lk(&mtx);
+        if (!ensureTable())
+            return;
+        model = modelName;
+    }
+
+    QList<QVariantList> bindValues;
+    for (int i = 0; i < texts.size(); i++) {
+        if (vectors[i].isEmpty())
+            continue;
+
+        QByteArray blob(reinterpret_cast<const char *>(vectors[i].constData()),
+                        vectors[i].size() * static_cast<int>(sizeof(float)));
+        bindValues << QVariantList { hashKey(model, texts[i]), blob };
+    }
+
+    QSqlDatabase *db = connection();
+    QString query = "INSERT OR REPLACE INTO " + QString(kChunkCacheTable) + " (hash, vector) VALUES (?, ?)";
+    if (!EmbedDBVendorIns->commitPrepared(db, query, bindValues))
+        return;
+
+    // 只由越过阈值的线程检查容量
+    bool needTrim = false;
+    {
+        QMutexLocker lk(&mtx);
+        insertCount += bindValues.size();
+        if (insertCount >= kChunkCacheTrimInterval) {
+            insertCount = 0;
+            needTrim = true;
+        }
+    }
+    if (needTrim)
+        trim(db);
+}
+
+QString ChunkEmbeddingCache::hashKey(const QString &model, const QString &text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(model.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(text.toUtf8());
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QSqlDatabase *ChunkEmbeddingCache::connection()
+{
+    // QSqlDatabase 连接只能在创建它的线程使用
+    static thread_local ThreadConnection conn;
+    if (!conn.db.isValid())
+        conn.db = EmbedDBVendorIns->addDatabase(dbPath);
+    return &conn.db;
+}
+
+bool ChunkEmbeddingCache::ensureTable()
+{
+    if (tableReady)
+        return true;
+
+    // WAL 模式记录在库文件中，多个连接并发读写时读不被写阻塞
+    QSqlDatabase *db = connection();
+    EmbedDBVendorIns->executeQuery(db, "PRAGMA journal_mode=WAL");
+    QString query = "CREATE TABLE IF NOT EXISTS " + QString(kChunkCacheTable)
+            + " (hash TEXT PRIMARY KEY, vector BLOB)";
+    tableReady = EmbedDBVendorIns->executeQuery(db, query);
+    return tableReady;
+}
+
+void ChunkEmbeddingCache::trim(QSqlDatabase *db)
+{
+    // 超出容量时按写入顺序淘汰最早的条目
+    QList<QVariantList> result;
+    EmbedDBVendorIns->executeQuery(db, "SELECT COUNT(*) FROM " + QString(kChunkCacheTable), result);
+    if (result.isEmpty() || !result[0][0].isValid())
+        return;
+
+    const qint64 overflow = result[0][0].toLongLong() - capacity;
+    if (overflow <= 0)
+        return;
+
+    QString query = "DELETE FROM " + QString(kChunkCacheTable) + " WHERE rowid IN (SELECT rowid FROM "
+            + QString(kChunkCacheTable) + " ORDER BY rowid LIMIT " + QString::number(overflow) + ")";
+    EmbedDBVendorIns->executeQuery(db, query);
+    qInfo() << "trim chunk embedding cache:" << overflow;
+}
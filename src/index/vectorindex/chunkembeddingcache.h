@@ -0,0 +1,44 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef CHUNKEMBEDDINGCACHE_H
+#define CHUNKEMBEDDINGCACHE_H
+
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+#define ChunkEmbeddingCacheIns ChunkEmbeddingCache::instance()
+
+// 文本块向量持久化缓存：以 hash(模型名 + 文本) 为键，各应用共享，相同文本不重复向量化
+class ChunkEmbeddingCache
+{
+public:
+    static ChunkEmbeddingCache *instance();
+
+    void setModel(const QString &model);
+
+    // 未命中的文本对应空向量
+    QVector<QVector<float>> find(const QStringList &texts);
+    void insert(const QStringList &texts, const QVector<QVector<float>> &vectors);
+
+private:
+    explicit ChunkEmbeddingCache();
+    static QString hashKey(const QString &model, const QString &text);
+    QSqlDatabase *connection();
+    bool ensureTable();
+    void trim(QSqlDatabase *db);
+
+    QString dbPath;
+    int capacity = 0;
+
+    // 锁只保护以下成员，读写数据库在锁外，各线程使用自己的连接
+    QMutex mtx;
+    QString modelName;
+    int insertCount = 0;
+    bool tableReady = false;
+};
+
+#endif // CHUNKEMBEDDINGCACHE_H
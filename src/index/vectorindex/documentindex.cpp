@@ -0,0 +1,329 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "documentindex.h"
+#include "../global_define.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QDebug>
+
+#include <faiss/index_factory.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/impl/FaissException.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static constexpr quint32 kDocumentIndexMagic { 0x44494432 };   // "DID2"
+
+DocumentIndex::DocumentIndex(const QString &sidecarPath, faiss::MetricType metric)
+    : sidecarPath(sidecarPath)
+    , metric(metric)
+{
+}
+
+DocumentIndex::~DocumentIndex()
+{
+    delete index;
+}
+
+bool DocumentIndex::load(qint64 &metaCount, qint64 &metaLastID)
+{
+    QFile file(sidecarPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 fileMetric = 0;
+    qint32 d = 0;
+    qint64 key = 0;
+    qint64 fileMetaCount = -1;
+    qint64 fileMetaLastID = -1;
+    qint32 docCount = 0;
+    in >> magic >> fileMetric >> d >> key >> fileMetaCount >> fileMetaLastID >> docCount;
+    // 度量配置变更后质心不可再用，由落盘段重建
+    if (in.status() != QDataStream::Ok || magic != kDocumentIndexMagic || fileMetric != metric || d <= 0) {
+        qWarning() << "invalid document index file" << sidecarPath;
+        return false;
+    }
+
+    QHash<QString, Document> docs;
+    QHash<faiss::idx_t, QString> sources;
+    QVector<float> centroids;
+    QVector<faiss::idx_t> keys;
+    docs.reserve(docCount);
+    centroids.reserve(docCount * d);
+    keys.reserve(docCount);
+    for (qint32 i = 0; i < docCount && in.status() == QDataStream::Ok; i++) {
+        QString source;
+        Document doc;
+        qint64 docKey = -1;
+        qint32 chunkCount = 0;
+        in >> source >> docKey >> doc.norm >> chunkCount;
+        doc.key = docKey;
+        doc.chunks.resize(qMax(0, chunkCount));
+        for (faiss::idx_t &id : doc.chunks) {
+            qint64 value = -1;
+            in >> value;
+            id = value;
+        }
+
+        QByteArray centroid;
+        in >> centroid;
+        if (centroid.size() != d * static_cast<int>(sizeof(float)))
+            break;
+
+        centroids.resize(centroids.size() + d);
+        memcpy(centroids.data() + centroids.size() - d, centroid.constData(), static_cast<size_t>(centroid.size()));
+        keys << doc.key;
+        sources.insert(doc.key, source);
+        docs.insert(source, doc);
+    }
+
+    if (in.status() != QDataStream::Ok || docs.size() != docCount) {
+        qWarning() << "broken document index file" << sidecarPath;
+        return false;
+    }
+
+    QWriteLocker lk(&rwLock);
+    createIndex(d);
+    if (!keys.isEmpty())
+        index->add_with_ids(keys.size(), centroids.constData(), keys.constData());
+    documents = docs;
+    keySources = sources;
+    nextKey = key;
+    savedVersion = version;
+    savedMetaCount = metaCount = fileMetaCount;
+    savedMetaLastID = metaLastID = fileMetaLastID;
+    return true;
+}
+
+bool DocumentIndex::save(qint64 metaCount, qint64 metaLastID)
+{
+    QByteArray data;
+    quint64 snapshot = 0;
+    {
+        QReadLocker lk(&rwLock);
+        if (version == savedVersion && metaCount == savedMetaCount && metaLastID == savedMetaLastID)
+            return true;
+        snapshot = version;
+
+        const int d = index ? index->d : 0;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out << kDocumentIndexMagic << static_cast<qint32>(metric) << static_cast<qint32>(d)
+            << static_cast<qint64>(nextKey) << metaCount << metaLastID << static_cast<qint32>(documents.size());
+
+        QByteArray centroid(d * static_cast<int>(sizeof(float)), Qt::Uninitialized);
+        for (auto it = documents.constBegin(); it != documents.constEnd(); ++it) {
+            const Document &doc = it.value();
+            out << it.key() << static_cast<qint64>(doc.key) << doc.norm << static_cast<qint32>(doc.chunks.size());
+            for (faiss::idx_t id : doc.chunks)
+                out << static_cast<qint64>(id);
+
+            index->reconstruct(doc.key, reinterpret_cast<float *>(centroid.data()));
+            out << centroid;
+        }
+    }
+
+    QSaveFile file(sidecarPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write document index file" << sidecarPath;
+        return false;
+    }
+    file.write(data);
+    if (!file.commit())
+        return false;
+
+    // 写入期间的变更留待下次保存
+    QWriteLocker lk(&rwLock);
+    savedVersion = snapshot;
+    savedMetaCount = metaCount;
+    savedMetaLastID = metaLastID;
+    return true;
+}
+
+void DocumentIndex::add(const QString &source, const QVector<faiss::idx_t> &ids, const float *vectors, int d)
+{
+    if (ids.isEmpty() || d <= 0)
+        return;
+
+    QWriteLocker lk(&rwLock);
+    if (!index)
+        createIndex(d);
+    if (index->d != d)
+        return;
+
+    auto it = documents.find(source);
+    const bool exists = it != documents.end();
+    if (!exists) {
+        Document doc;
+        doc.key = nextKey++;
+        it = documents.insert(source, doc);
+        keySources.insert(doc.key, source);
+    }
+
+    // 由已有的质心恢复向量之和，再累加新的文本块
+    Document &doc = it.value();
+    QVector<float> sum(d, 0.f);
+    if (exists && !doc.chunks.isEmpty()) {
+        index->reconstruct(doc.key, sum.data());
+        const float scale = doc.norm * doc.chunks.size();
+        for (float &v : sum)
+            v *= scale;
+    }
+
+    int added = 0;
+    for (int i = 0; i < ids.size(); i++) {
+        auto pos = std::lower_bound(doc.chunks.begin(), doc.chunks.end(), ids[i]);
+        if (pos != doc.chunks.end() && *pos == ids[i])
+            continue;
+
+        doc.chunks.insert(pos, ids[i]);
+        const float *vector = vectors + static_cast<size_t>(i) * d;
+        for (int j = 0; j < d; j++)
+            sum[j] += vector[j];
+        added++;
+    }
+    if (added == 0)
+        return;
+
+    if (exists) {
+        faiss::IDSelectorArray sel(1, &doc.key);
+        index->remove_ids(sel);
+    }
+    addCentroid(doc, sum);
+}
+
+void DocumentIndex::remove(const QStringList &sources)
+{
+    QWriteLocker lk(&rwLock);
+    std::vector<faiss::idx_t> keys;
+    for (const QString &source : sources) {
+        auto it = documents.find(source);
+        if (it == documents.end())
+            continue;
+
+        keys.push_back(it.value().key);
+        keySources.remove(it.value().key);
+        documents.erase(it);
+    }
+
+    if (keys.empty() || !index)
+        return;
+
+    // 批量删除只重排一次质心
+    faiss::IDSelectorBatch sel(keys.size(), keys.data());
+    index->remove_ids(sel);
+    version++;
+}
+
+void DocumentIndex::reset(const QHash<QString, QVector<faiss::idx_t>> &chunks, const QHash<QString, QVector<float>> &sums, int d)
+{
+    QWriteLocker lk(&rwLock);
+    createIndex(d);
+    documents.clear();
+    keySources.clear();
+    nextKey = 0;
+    version++;
+
+    for (auto it = chunks.constBegin(); it != chunks.constEnd(); ++it) {
+        QVector<float> sum = sums.value(it.key());
+        if (it.value().isEmpty() || sum.size() != d)
+            continue;
+
+        Document doc;
+        doc.key = nextKey++;
+        doc.chunks = it.value();
+        std::sort(doc.chunks.begin(), doc.chunks.end());
+        addCentroid(doc, sum);
+        keySources.insert(doc.key, it.key());
+        documents.insert(it.key(), doc);
+    }
+}
+
+int DocumentIndex::count()
+{
+    QReadLocker lk(&rwLock);
+    return documents.size();
+}
+
+faiss::idx_t DocumentIndex::lastChunkID()
+{
+    QReadLocker lk(&rwLock);
+    faiss::idx_t last = -1;
+    for (const Document &doc : documents) {
+        if (!doc.chunks.isEmpty())
+            last = qMax(last, doc.chunks.last());
+    }
+    return last;
+}
+
+std::vector<faiss::idx_t> DocumentIndex::select(int nq, const float *queries, int topM)
+{
+    std::vector<faiss::idx_t> ids;
+
+    QReadLocker lk(&rwLock);
+    if (!index || index->ntotal == 0 || nq < 1 || topM < 1)
+        return ids;
+
+    const int k = static_cast<int>(qMin<faiss::idx_t>(topM, index->ntotal));
+    QVector<float> distances(nq * k);
+    QVector<faiss::idx_t> keys(nq * k, -1);
+    try {
+        index->search(nq, queries, k, distances.data(), keys.data());
+    } catch (faiss::FaissException &e) {
+        std::cerr << "Faiss error: " << e.what() << std::endl;
+        return ids;
+    }
+
+    // 多个查询选中的文档取并集，合并后仍只需一次段检索
+    QSet<faiss::idx_t> selected;
+    for (faiss::idx_t key : keys) {
+        if (key < 0 || selected.contains(key))
+            continue;
+
+        selected.insert(key);
+        auto it = documents.constFind(keySources.value(key));
+        if (it != documents.constEnd())
+            ids.insert(ids.end(), it.value().chunks.constBegin(), it.value().chunks.constEnd());
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+void DocumentIndex::createIndex(int d)
+{
+    delete index;
+    index = new faiss::IndexIDMap2(faiss::index_factory(d, kFaissFlatIndex, metric));
+    index->own_fields = true;
+}
+
+void DocumentIndex::addCentroid(Document &doc, QVector<float> &sum)
+{
+    // 均值向量；内积度量下归一化，使质心与查询的内积即余弦相似度
+    const float count = static_cast<float>(doc.chunks.size());
+    double norm = 0;
+    for (float &v : sum) {
+        v /= count;
+        norm += static_cast<double>(v) * v;
+    }
+
+    doc.norm = 1.f;
+    if (metric == faiss::METRIC_INNER_PRODUCT && norm > 0) {
+        doc.norm = static_cast<float>(std::sqrt(norm));
+        for (float &v : sum)
+            v /= doc.norm;
+    }
+
+    index->add_with_ids(1, sum.constData(), &doc.key);
+    version++;
+}
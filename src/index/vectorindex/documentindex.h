@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef DOCUMENTINDEX_H
+#define DOCUMENTINDEX_H
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <faiss/Index.h>
+#include <faiss/IndexIDMap.h>
+
+#include <vector>
+
+// 文档级索引：每篇文档一个质心向量(各文本块向量的均值，内积度量下归一化)，
+// 检索时先选出与查询相近的文档，再只计算这些文档的文本块；常驻内存并以旁路文件持久化
+class DocumentIndex
+{
+public:
+    DocumentIndex(const QString &sidecarPath, faiss::MetricType metric);
+    ~DocumentIndex();
+
+    // 旁路文件同时记录保存时元数据表的文本块数与最大 id，加载后由调用方与元数据表比对
+    bool load(qint64 &metaCount, qint64 &metaLastID);
+    // 仅在有变更时写入
+    bool save(qint64 metaCount, qint64 metaLastID);
+
+    // 追加文档的文本块向量，已收录的文本块 id 忽略
+    void add(const QString &source, const QVector<faiss::idx_t> &ids, const float *vectors, int d);
+    void remove(const QStringList &sources);
+    // 以各文档的文本块 id 与向量之和整体替换，用于由落盘段重建
+    void reset(const QHash<QString, QVector<faiss::idx_t>> &chunks, const QHash<QString, QVector<float>> &sums, int d);
+
+    int count();
+    // 已收录的最大文本块 id，没有时为 -1
+    faiss::idx_t lastChunkID();
+
+    // 每个查询选出 topM 篇最相近的文档，返回这些文档全部文本块 id 的并集(升序)
+    std::vector<faiss::idx_t> select(int nq, const float *queries, int topM);
+
+private:
+    struct Document
+    {
+        faiss::idx_t key = -1;
+        QVector<faiss::idx_t> chunks;   // 升序
+        float norm = 1.f;   // 归一化前均值向量的模，用于恢复向量之和
+    };
+
+    void createIndex(int d);
+    void addCentroid(Document &doc, QVector<float> &sum);
+
+    QString sidecarPath;
+    faiss::MetricType metric = faiss::METRIC_L2;
+
+    faiss::IndexIDMap2 *index = nullptr;
+    QHash<QString, Document> documents;
+    QHash<faiss::idx_t, QString> keySources;
+    faiss::idx_t nextKey = 0;
+    quint64 version = 0;   // 每次变更递增
+    quint64 savedVersion = 0;
+    qint64 savedMetaCount = -1;
+    qint64 savedMetaLastID = -1;
+
+    QReadWriteLock rwLock;
+};
+
+#endif // DOCUMENTINDEX_H
@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "documentreader.h"
+#include "utils/utils.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QTextCodec>
+#include <QDebug>
+
+#include <docparser.h>
+
+static constexpr qint64 kReadBlockSize { 64 * 1024 };
+
+static bool isAscii(const QByteArray &data)
+{
+    for (char c : data) {
+        if (static_cast<uchar>(c) & 0x80)
+            return false;
+    }
+    return true;
+}
+
+bool DocumentReader::isPlainText(const QString &file)
+{
+    const QString suffix = QFileInfo(file).suffix();
+    return suffix == "txt" || suffix == "text";
+}
+
+qint64 DocumentReader::read(const QString &file, TextChunker &chunker)
+{
+    if (isPlainText(file))
+        return readPlainText(file, chunker);
+    return readConverted(file, chunker);
+}
+
+qint64 DocumentReader::readPlainText(const QString &file, TextChunker &chunker)
+{
+    QFile in(file);
+    if (!in.open(QIODevice::ReadOnly)) {
+        qWarning() << "can not open" << file << in.errorString();
+        return -1;
+    }
+
+    // 文本类型由开头的数据判定
+    QByteArray block = in.read(kReadBlockSize);
+    if (!Utils::isValidContent(block.constData(), block.size()))
+        return -1;
+
+    // ASCII 在各种编码下解码结果相同，遇到第一个含非 ASCII 字节的块时再检测编码
+    QScopedPointer<QTextDecoder> decoder;
+    QString text;
+    qint64 total = 0;
+    while (!block.isEmpty() && !chunker.isFull()) {
+        if (!decoder && isAscii(block)) {
+            text = QString::fromLatin1(block);
+        } else {
+            if (!decoder)
+                decoder.reset(Utils::codecForData(block.constData(), block.size())->makeDecoder());
+            decoder->toUnicode(&text, block.constData(), block.size());
+        }
+
+        chunker.append(text);
+        total += text.size();
+        block = in.read(kReadBlockSize);
+    }
+
+    return total;
+}
+
+qint64 DocumentReader::readConverted(const QString &file, TextChunker &chunker)
+{
+    const std::string content = DocParser::convertFile(file.toStdString());
+    const char *data = content.data();
+    const qint64 size = static_cast<qint64>(content.size());
+    if (!Utils::isValidContent(data, size))
+        return -1;
+
+    // 按块解码后直接送入分块器，不生成整篇文档的 QString
+    QScopedPointer<QTextDecoder> decoder(Utils::codecForData(data, size)->makeDecoder());
+    QString text;
+    qint64 total = 0;
+    for (qint64 pos = 0; pos < size && !chunker.isFull(); pos += kReadBlockSize) {
+        decoder->toUnicode(&text, data + pos, static_cast<int>(qMin(kReadBlockSize, size - pos)));
+        chunker.append(text);
+        total += text.size();
+    }
+
+    return total;
+}
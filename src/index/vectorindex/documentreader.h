@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef DOCUMENTREADER_H
+#define DOCUMENTREADER_H
+
+#include "textchunker.h"
+
+#include <QString>
+
+// 提取文档文本并送入分块器
+// 纯文本文件按块读取、流式解码，分块器达到数量上限即停止读取，内存占用与文件大小无关；
+// 其余格式只能由 DocParser 整体转换
+class DocumentReader
+{
+public:
+    static bool isPlainText(const QString &file);
+
+    // 返回送入分块器的字符数，文档无效时返回 -1
+    static qint64 read(const QString &file, TextChunker &chunker);
+
+private:
+    static qint64 readPlainText(const QString &file, TextChunker &chunker);
+    static qint64 readConverted(const QString &file, TextChunker &chunker);
+};
+
+#endif // DOCUMENTREADER_H
@@ -4,201 +4,241 @@
 
 #include "embedding.h"
 #include "vectorindex.h"
+#include "queryembeddingcache.h"
+#include "chunkembeddingcache.h"
+#include "embeddingbatcher.h"
+#include "embeddingdecoder.h"
+#include "lanescheduler.h"
+#include "textchunker.h"
+#include "documentreader.h"
 #include "database/embeddatabase.h"
 #include "../global_define.h"
-#include "utils/utils.h"
+#include "config/configmanager.h"
 
-#include <QRegularExpression>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QSet>
 #include <QtConcurrent/QtConcurrent>
 
-#include <docparser.h>
+#include <faiss/utils/distances.h>
 
 static constexpr char kSearchResultDistance[] { "distance" };
+static constexpr int kEmbedBatchRetries { 2 };   // 请求失败后缩小批次重试的次数
 
 Embedding::Embedding(QSqlDatabase *db, QMutex *mtx, const QString &appID, QObject *parent)
     : QObject(parent)
     , dataBase(db)
     , dbMtx(mtx)
+    , queryDataBase(db)
+    , queryDbMtx(mtx)
     , appID(appID)
 {
     Q_ASSERT(db);
     Q_ASSERT(mtx);
+    metric = VectorIndex::metricType(appID);
+    chunkOverlap = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_CHUNK_OVERLAP, 0).toInt();
+    chunkDelimiters = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_CHUNK_DELIMITERS,
+                                              TextChunker::defaultDelimiters()).toString();
 }
 
 bool Embedding::embeddingDocument(const QString &docFilePath)
 {
+    IngestDocument doc;
+    if (!prepareDocument(docFilePath, false, doc))
+        return false;
+
+    //向量化文本块，生成向量vector
+    doc.vectors = embeddingTexts(doc.chunks);
+    return appendDocument(doc);
+}
+
+bool Embedding::embeddingDocumentSaveAs(const QString &docFilePath)
+{
+    // Embedding SaveAs
+    // uos-ai
+    IngestDocument doc;
+    if (!prepareDocument(docFilePath, true, doc))
+        return false;
+
+    //向量化文本块，生成向量vector
+    doc.vectors = embeddingTexts(doc.chunks);
+    return appendDocument(doc);
+}
+
+bool Embedding::prepareDocument(const QString &docFilePath, bool saveAs, IngestDocument &doc)
+{
+    // 解析与分块，不修改缓存，可在多个线程并发执行
     QFileInfo docFile(docFilePath);
     if (!docFile.exists()) {
         qWarning() << docFilePath << "not exist";
         return false;
     }
 
-    if (isDupDocument(docFilePath)) {
-        qWarning() << docFilePath << "dump doc duplicate";
+    QString source = saveAs ? saveAsDocPath(docFilePath) : docFilePath;
+    if (isDupDocument(source)) {
+        qWarning() << source << "dump doc duplicate";
         return false;
     }
 
-    for (auto id : embedDataCache.keys()) {
-        if (docFilePath == embedDataCache.value(id).first) {
-            qWarning() << docFilePath << "cache doc duplicate";
-            return false;
-        }
-    }
-
-    std::string stdStrContents = DocParser::convertFile(docFilePath.toStdString());
-    QString contents = Utils::textEncodingTransferUTF8(stdStrContents);
-
-    if (!Utils::isValidContent(stdStrContents)) {
-        qDebug() << "Invalid document content.";
+    if (isCacheDocument(source)) {
+        qWarning() << source << "cache doc duplicate";
         return false;
     }
 
     //文本分块
-    QStringList chunks;
-    if (!contents.isEmpty())
-        chunks = textsSpliter(contents);
+    TextChunker chunker;
+    chunker.setOverlap(chunkOverlap);
+    chunker.setDelimiters(chunkDelimiters);
 
     // 文件名大于14字节建索引
-    if (docFile.baseName().toUtf8().size() > 14) {
-        chunks.prepend(docFile.fileName());
-    }
-
-    if (chunks.isEmpty())
+    const bool withName = !saveAs && docFile.baseName().toUtf8().size() > 14;
+    // 只需前100个，分块达到数量后不再读取剩余文本
+    if (!saveAs)
+        chunker.setMaxChunks(withName ? 99 : 100);
+
+    // 文本边读取边分块，不在内存中保留整篇文档
+    qint64 length = DocumentReader::read(docFilePath, chunker);
+    if (length < 0) {
+        qDebug() << "Invalid document content.";
         return false;
-
-    qDebug() << "embedding " << docFilePath << chunks.size();
-    // 只需前100个
-    if (chunks.size() > 100) {
-        chunks = chunks.mid(0, 100);
-        qDebug() << "Get the top 100 chunks" << docFilePath;
     }
 
-    //向量化文本块，生成向量vector
-    QVector<QVector<float>> vectors;
-    vectors = embeddingTexts(chunks);
-
-    if (vectors.count() != chunks.count())
-        return false;
-    if (vectors.isEmpty())
-        return false;
-
-    {
-        QMutexLocker lk(&embeddingMutex);
-        //元数据、文本存储
-        int continueID = embedDataCache.size() + getDBLastID();
-        qInfo() << "-------------" << continueID;
+    QStringList chunks;
+    if (saveAs) {
+        if (length == 0)
+            return false;
+        qInfo() << "embedding " << source;
+        chunker.finish();
+        chunks = chunker.chunks();
+    } else {
+        if (length > 0) {
+            chunker.finish();
+            chunks = chunker.chunks();
+            if (chunker.isFull())
+                qDebug() << "Get the top 100 chunks" << docFilePath;
+        }
 
-        for (int i = 0; i < chunks.count(); i++) {
-            if (chunks[i].isEmpty())
-                continue;
+        if (withName) {
+            chunks.prepend(docFile.fileName());
+        }
 
-            embedDataCache.insert(continueID, QPair<QString, QString>(docFilePath, chunks[i]));
-            embedVectorCache.insert(continueID, vectors[i]);
+        if (chunks.isEmpty())
+            return false;
 
-            continueID += 1;
-        }
+        qDebug() << "embedding " << docFilePath << chunks.size();
     }
+
+    doc.file = docFilePath;
+    doc.source = source;
+    doc.chunks = chunks;
     return true;
 }
 
-bool Embedding::embeddingDocumentSaveAs(const QString &docFilePath)
+bool Embedding::appendDocument(const IngestDocument &doc)
 {
-    // Embedding SaveAs
-    // uos-ai
-    QFileInfo docFile(docFilePath);
-    if (!docFile.exists()) {
-        qWarning() << docFilePath << "not exist";
+    if (doc.vectors.count() != doc.chunks.count())
         return false;
-    }
-
-    QString newDocPath = saveAsDocPath(docFilePath);
-
-    if (isDupDocument(newDocPath)) {
-        qWarning() << newDocPath << "dump doc duplicate";
+    if (doc.vectors.isEmpty())
         return false;
-    }
 
-    for (auto id : embedDataCache.keys()) {
-        if (newDocPath == embedDataCache.value(id).first) {
-            qWarning() << newDocPath << "cache doc duplicate";
+    QMutexLocker lk(&embeddingMutex);
+    // 并发解析期间同一文档可能被重复提交
+    for (const QPair<QString, QString> &data : embedDataCache) {
+        if (data.first == doc.source) {
+            qWarning() << doc.source << "cache doc duplicate";
             return false;
         }
     }
 
-    std::string stdStrContents = DocParser::convertFile(docFilePath.toStdString());
-    QString contents = Utils::textEncodingTransferUTF8(stdStrContents);
-
-    if (!Utils::isValidContent(stdStrContents)) {
-        qDebug() << "Invalid document content.";
-        return false;
-    }
-
-    if (contents.isEmpty())
-        return false;
-    qInfo() << "embedding " << newDocPath;
-
-    //文本分块
-    QStringList chunks;
-    chunks = textsSpliter(contents);
-    //向量化文本块，生成向量vector
-    QVector<QVector<float>> vectors;
-    vectors = embeddingTexts(chunks);
-
-    if (vectors.count() != chunks.count())
-        return false;
-    if (vectors.isEmpty())
-        return false;
-
-    {
-        QMutexLocker lk(&embeddingMutex);
-        //元数据、文本存储
-        int continueID = embedDataCache.size() + getDBLastID();
-        qInfo() << "-------------" << continueID;
+    //元数据、文本存储
+    // 缓存中删除过文档时 ID 不连续，从已用的最大 ID 之后分配，避免覆盖后入库的文本块
+    faiss::idx_t continueID = getDBLastID();
+    if (!embedDataCache.isEmpty())
+        continueID = qMax(continueID, embedDataCache.lastKey() + 1);
+    qInfo() << "-------------" << continueID;
 
-        for (int i = 0; i < chunks.count(); i++) {
-            if (chunks[i].isEmpty())
-                continue;
+    for (int i = 0; i < doc.chunks.count(); i++) {
+        if (doc.chunks[i].isEmpty())
+            continue;
 
-            embedDataCache.insert(continueID, QPair<QString, QString>(newDocPath, chunks[i]));
-            embedVectorCache.insert(continueID, vectors[i]);
+        embedDataCache.insert(continueID, QPair<QString, QString>(doc.source, doc.chunks[i]));
+        embedVectorCache.insert(continueID, doc.vectors[i]);
 
-            continueID += 1;
-        }
+        continueID += 1;
     }
 
     return true;
 }
 
+bool Embedding::isCacheDocument(const QString &source)
+{
+    QMutexLocker lk(&embeddingMutex);
+    for (const QPair<QString, QString> &data : embedDataCache) {
+        if (source == data.first)
+            return true;
+    }
+    return false;
+}
+
 QVector<QVector<float>> Embedding::embeddingTexts(const QStringList &texts)
 {
     if (texts.isEmpty())
         return {};
 
-    int inputBatch = 15;
-    QVector<QVector<float>> vectors;
-    QStringList splitProcessText = texts;
+    // 已向量化过的相同文本直接取缓存，只有未命中的文本分批请求模型
+    QVector<QVector<float>> vectors = ChunkEmbeddingCacheIns->find(texts);
+    QStringList splitProcessText;
+    QVector<int> missIndexes;
+    for (int i = 0; i < texts.size(); i++) {
+        if (vectors[i].isEmpty()) {
+            splitProcessText << texts[i];
+            missIndexes << i;
+        }
+    }
+    qDebug() << "chunk embedding cache hit" << texts.size() - missIndexes.size() << "of" << texts.size();
+
+    // 批大小由 EmbeddingBatcher 按字符预算和服务延迟决定，失败时缩小批次重试
     int currentIndex = 0;
+    int retries = 0;
     while (currentIndex < splitProcessText.size()) {
+        int inputBatch = EmbeddingBatcherIns->nextBatchSize(splitProcessText, currentIndex);
         QStringList subList = splitProcessText.mid(currentIndex, inputBatch);
-        currentIndex += inputBatch;
-
-        QJsonObject emdObject = onHttpEmbedding(subList, apiData);
-        QJsonArray embeddingsArray = emdObject["data"].toArray();
-        for(auto embeddingObject : embeddingsArray) {
-            QJsonArray vectorArray = embeddingObject.toObject()["embedding"].toArray();
-            QVector<float> vectorTmp;
-            for (auto value : vectorArray) {
-                vectorTmp << static_cast<float>(value.toDouble());
-            }
-            vectors << vectorTmp;
+        int chars = 0;
+        for (const QString &text : subList)
+            chars += text.size();
+
+        // 批次边界为检索让出模型服务
+        LaneSchedulerIns->yield();
+
+        QElapsedTimer timer;
+        timer.start();
+        EmbeddingBatcherIns->acquire();
+        QByteArray response = onHttpEmbedding(subList, apiData);
+        EmbeddingBatcherIns->release();
+        QVector<QVector<float>> subVectors;
+        bool ok = EmbeddingDecoder::decode(response, subList.size(), subVectors);
+        EmbeddingBatcherIns->report(subList.size(), chars, timer.elapsed(), ok);
+        if (!ok) {
+            if (inputBatch > 1 && ++retries <= kEmbedBatchRetries)
+                continue;
+            return {};
         }
+        retries = 0;
+
+        // 缓存模型原始输出
+        ChunkEmbeddingCacheIns->insert(subList, subVectors);
+        for (int i = 0; i < subVectors.size(); i++)
+            vectors[missIndexes[currentIndex + i]] = subVectors[i];
+        currentIndex += inputBatch;
     }
+
+    for (QVector<float> &vector : vectors)
+        normalizeVector(vector);
     return vectors;
 }
 
@@ -210,20 +250,43 @@ void Embedding::embeddingQuery(const QString &query, QVector<float> &queryVector
      * 调用接口将query进行向量化，结果通过queryVector传递float指针
     */
 
+    QVector<QVector<float>> queryVectors = embeddingQueries(QStringList(query));
+    if (!queryVectors.isEmpty())
+        queryVector << queryVectors.first();
+}
+
+QVector<QVector<float>> Embedding::embeddingQueries(const QStringList &queries)
+{
+    // 先查查询向量缓存，未命中的查询一次请求完成向量化
+    QVector<QVector<float>> queryVectors(queries.size());
     QStringList queryTexts;
-    queryTexts << "为这个句子生成表示以用于检索相关文章:" + query;
-    QJsonObject emdObject;
-    emdObject = onHttpEmbedding(queryTexts, apiData);
-
-    //获取query
-    //local
-    QJsonArray embeddingsArray = emdObject["data"].toArray();
-    for(auto embeddingObject : embeddingsArray) {
-        QJsonArray vectorArray = embeddingObject.toObject()["embedding"].toArray();
-        for (auto value : vectorArray) {
-            queryVector << static_cast<float>(value.toDouble());
+    QVector<int> missIndexes;
+    for (int i = 0; i < queries.size(); i++) {
+        if (QueryEmbeddingCacheIns->find(queries[i], queryVectors[i]))
+            continue;
+
+        queryTexts << "为这个句子生成表示以用于检索相关文章:" + QueryEmbeddingCache::normalizeQuery(queries[i]);
+        missIndexes << i;
+    }
+
+    if (!queryTexts.isEmpty()) {
+        QByteArray response = onHttpEmbedding(queryTexts, apiData);
+
+        //获取query
+        QVector<QVector<float>> vectors;
+        if (!EmbeddingDecoder::decode(response, missIndexes.size(), vectors))
+            return {};
+
+        for (int i = 0; i < missIndexes.size(); i++) {
+            // 缓存模型原始输出，归一化与否取决于各应用的度量
+            QueryEmbeddingCacheIns->insert(queries[missIndexes[i]], vectors[i]);
+            queryVectors[missIndexes[i]] = vectors[i];
         }
     }
+
+    for (QVector<float> &vector : queryVectors)
+        normalizeVector(vector);
+    return queryVectors;
 }
 
 bool Embedding::batchInsertDataToDB(const QStringList &inserQuery)
@@ -305,64 +368,78 @@ QMap<faiss::idx_t, QPair<QString, QString>> Embedding::getEmbedDataCache()
     return embedDataCache;
 }
 
-QStringList Embedding::textsSpliter(QString &texts)
+QPair<QString, QString> Embedding::getDataCacheFromID(const faiss::idx_t &id)
 {
-    QStringList chunks;
-    QStringList splitTexts;
-
-    QRegularExpression regexSplit("[\n，；。,.]");
-    QRegularExpression regexInvalidChar("[\\s\u200B]+");
-    texts.replace(regexInvalidChar, " ");
-    texts.replace("'", "\""); //SQL语句有单引号会报错
-
-    splitTexts = texts.split(regexSplit, QString::SplitBehavior::SkipEmptyParts);
+    QMutexLocker lk(&embeddingMutex);
+    return embedDataCache.value(id);
+}
 
-    QString over = "";
-    for (auto text : splitTexts) {
-        text = over + text;
-        over = "";
+bool Embedding::getDataFromDB(const faiss::idx_t &id, QPair<QString, QString> &data)
+{
+    if (appID == kSystemAssistantKey) {
+        loadReadOnlyData();
+        auto it = readOnlyData.constFind(id);
+        if (it == readOnlyData.constEnd())
+            return false;
 
-        if (text.length() > kMaxChunksSize) {
-            textsSplitSize(text, chunks, over);
-        } else if (text.length() > kMinChunksSize && text.length() < kMaxChunksSize) {
-            chunks << text;
-        } else {
-            over = text;
-        }
+        data = it.value();
+        return true;
     }
 
-    if (over.length() > kMinChunksSize)
-        chunks << over;
-    else {
-        if (chunks.isEmpty())
-            chunks << over;
-        else
-            chunks.last() += over;
+    QList<QVariantList> result;
+    {
+        QString query = "SELECT * FROM " + QString(kEmbeddingDBMetaDataTable) + " WHERE id = " + QString::number(id);
+        QMutexLocker lk(queryDbMtx);
+        EmbedDBVendorIns->executeQuery(queryDataBase, query, result);
     }
 
-    return chunks;
+    if (result.isEmpty())
+        return false;
+
+    QVariantList &res = result[0];
+    if (!res[1].isValid() || !res[2].isValid())
+        return false;
+
+    data = qMakePair(res[1].toString(), res[2].toString());
+    return true;
 }
 
-void Embedding::textsSplitSize(const QString &text, QStringList &splits, QString &over, int pos)
+void Embedding::loadReadOnlyData()
 {
-    if (pos >= text.length()) {
+    QMutexLocker lk(&readOnlyDataMtx);
+    if (readOnlyDataLoaded)
         return;
+
+    QList<QVariantList> result;
+    {
+        QString query = "SELECT id, source, content FROM " + QString(kEmbeddingDBMetaDataTable);
+        QMutexLocker dbLk(queryDbMtx);
+        readOnlyDataLoaded = EmbedDBVendorIns->executeQuery(queryDataBase, query, result);
     }
 
-    QString part = text.mid(pos, kMaxChunksSize);
+    // 同一文档的分块共享 source 字符串
+    QSet<QString> sources;
+    readOnlyData.reserve(result.size());
+    for (const QVariantList &res : result) {
+        if (!res[0].isValid() || !res[1].isValid() || !res[2].isValid())
+            continue;
 
-    if (part.length() < kMaxChunksSize) {
-        over += part;
-        return;
+        QString source = res[1].toString();
+        auto it = sources.constFind(source);
+        if (it == sources.constEnd())
+            it = sources.insert(source);
+
+        readOnlyData.insert(res[0].toLongLong(), qMakePair(*it, res[2].toString()));
     }
-    splits << part;
-    textsSplitSize(text, splits, over, pos + kMaxChunksSize);
+    qInfo() << appID << "load read-only metadata:" << readOnlyData.size();
 }
 
-QPair<QString, QString> Embedding::getDataCacheFromID(const faiss::idx_t &id)
+void Embedding::normalizeVector(QVector<float> &vector)
 {
-    QMutexLocker lk(&embeddingMutex);
-    return QPair<QString, QString>(embedDataCache[id].first, embedDataCache[id].second);
+    if (metric != faiss::METRIC_INNER_PRODUCT || vector.isEmpty())
+        return;
+
+    faiss::fvec_renorm_L2(static_cast<size_t>(vector.size()), 1, vector.data());
 }
 
 QString Embedding::saveAsDocPath(const QString &doc)
@@ -379,145 +456,63 @@ QString Embedding::saveAsDocPath(const QString &doc)
     return docDirStr + QDir::separator() + QFileInfo(doc).fileName();
 }
 
-QString Embedding::loadTextsFromSearch(int topK, const QMap<float, faiss::idx_t> &cacheSearchRes, const QMap<float, faiss::idx_t> &dumpSearchRes)
+QString Embedding::loadTextsFromSearch(int topK, const QVector<SearchResult> &searchResults)
 {
     QJsonObject resultObj;
     resultObj["version"] = SEARCH_RESULT_VERSION;
-    QJsonArray resultArray;
-
-    if (appID == kSystemAssistantKey) {
-        for (auto dumpIt : dumpSearchRes.keys()) {
-            faiss::idx_t id = dumpSearchRes.value(dumpIt);
-            QList<QVariantList> result;
-
-            QString query = "SELECT * FROM " + QString(kEmbeddingDBMetaDataTable) + " WHERE id = " + QString::number(id);
-            {
-                QMutexLocker lk(dbMtx);
-                EmbedDBVendorIns->executeQuery(dataBase, query, result);
-            }
-
-            if (result.isEmpty()) {
-                return {};
-            }
-
-            QVariantList &res = result[0];
-            if (!res[1].isValid() || !res[2].isValid())
-                continue;
-
-            QString source = res[1].toString();
-            QString content = res[2].toString();
-            QJsonObject obj;
-            obj[kEmbeddingDBMetaDataTableSource] = source;
-            obj[kEmbeddingDBMetaDataTableContent] = content;
-            obj[kSearchResultDistance] = static_cast<double>(dumpIt);
-            resultArray.append(obj);
-        }
-        resultObj["result"] = resultArray;
-        return QJsonDocument(resultObj).toJson(QJsonDocument::Compact);
-    }
-
-    //TODO:重排序\合并两种结果；两个距离有序数组的合并
-    int sort = 1;
-    int i = 0;
-    int j = 0;
-
-    while (i < cacheSearchRes.size() && j < dumpSearchRes.size()) {
-        if (sort > topK)
-            break;
-
-        auto cacheIt = cacheSearchRes.begin() + i;
-        auto dumpIt = dumpSearchRes.begin() + j;
-        if (cacheIt.key() < dumpIt.key()) {
-            QString source = getDataCacheFromID(cacheIt.value()).first;
-            QString content = getDataCacheFromID(cacheIt.value()).second;
-            QJsonObject obj;
-            obj[kEmbeddingDBMetaDataTableSource] = source;
-            obj[kEmbeddingDBMetaDataTableContent] = content;
-            obj[kSearchResultDistance] = static_cast<double>(cacheIt.key());
-            resultArray.append(obj);
-            sort++;
-            i++;
-        } else {
-            faiss::idx_t id = dumpIt.value();
-            QList<QVariantList> result;
+    resultObj["result"] = loadResultsFromSearch(topK, searchResults);
+    qDebug() << QString::fromUtf8(QJsonDocument(resultObj).toJson(QJsonDocument::Compact));
+    return QJsonDocument(resultObj).toJson(QJsonDocument::Compact);
+}
 
-            {
-                QString query = "SELECT * FROM " + QString(kEmbeddingDBMetaDataTable) + " WHERE id = " + QString::number(id);
-                QMutexLocker lk(dbMtx);
-                EmbedDBVendorIns->executeQuery(dataBase, query, result);
-            }
+QString Embedding::loadTextsFromSearch(int topK, const QVector<QVector<SearchResult>> &searchResults)
+{
+    // 批量检索：result 为每个查询的结果数组，顺序与查询一致
+    QJsonObject resultObj;
+    resultObj["version"] = SEARCH_RESULT_VERSION;
+    QJsonArray resultArray;
+    for (const QVector<SearchResult> &results : searchResults)
+        resultArray.append(loadResultsFromSearch(topK, results));
 
-            if (result.isEmpty()) {
-                j++;
-                continue;
-            }
+    resultObj["result"] = resultArray;
+    return QJsonDocument(resultObj).toJson(QJsonDocument::Compact);
+}
 
-            QVariantList &res = result[0];
-            if (!res[1].isValid() || !res[2].isValid())
-                continue;
+QJsonArray Embedding::loadResultsFromSearch(int topK, const QVector<SearchResult> &searchResults)
+{
+    QJsonArray resultArray;
 
-            QString source = res[1].toString();
-            QString content = res[2].toString();
-            QJsonObject obj;
-            obj[kEmbeddingDBMetaDataTableSource] = source;
-            obj[kEmbeddingDBMetaDataTableContent] = content;
-            obj[kSearchResultDistance] = static_cast<double>(dumpIt.key());
-            resultArray.append(obj);
-            sort++;
-            j++;
-        }
-    }
+    // 内积度量下 distance 为相似度，低于阈值的结果直接丢弃
+    const bool filterScore = metric == faiss::METRIC_INNER_PRODUCT;
+    const float minScore = ConfigManagerIns->value(VECTOR_INDEX_GROUP, appID + "." + VECTOR_INDEX_MIN_SCORE,
+                                                   0.0).toFloat();
 
-    while (i < cacheSearchRes.size()) {
-        if (sort > topK)
+    // searchResults 已按距离排序，内存缓存索引的结果 segment 为空
+    for (const SearchResult &res : searchResults) {
+        if (resultArray.size() >= topK)
             break;
 
-        auto cacheIt = cacheSearchRes.begin() + i;
-        QString source = getDataCacheFromID(cacheIt.value()).first;
-        QString content = getDataCacheFromID(cacheIt.value()).second;
-        QJsonObject obj;
-        obj[kEmbeddingDBMetaDataTableSource] = source;
-        obj[kEmbeddingDBMetaDataTableContent] = content;
-        obj[kSearchResultDistance] = static_cast<double>(cacheIt.key());
-        resultArray.append(obj);
-        sort++;
-        i++;
-    }
-
-    while (j < dumpSearchRes.size()) {
-        if (sort > topK)
+        if (filterScore && res.distance < minScore)
             break;
 
-        auto dumpIt = dumpSearchRes.begin() + j;
-        faiss::idx_t id = dumpIt.value();
-        QList<QVariantList> result;
-        {
-            QString query = "SELECT * FROM " + QString(kEmbeddingDBMetaDataTable) + " WHERE id = " + QString::number(id);
-            QMutexLocker lk(dbMtx);
-            EmbedDBVendorIns->executeQuery(dataBase, query, result);
-        }
-        if (result.isEmpty()) {
-            j++;
+        // 落盘过程中文本先写入元数据表再移出缓存，内存索引中的结果在缓存未命中时再查表
+        QPair<QString, QString> data;
+        if (res.segment.isEmpty())
+            data = getDataCacheFromID(res.id);
+        if (data.first.isEmpty() && !getDataFromDB(res.id, data))
             continue;
-        }
 
-        QVariantList &res = result[0];
-        if (!res[1].isValid() || !res[2].isValid())
+        if (data.first.isEmpty())
             continue;
 
-        QString source = res[1].toString();
-        QString content = res[2].toString();
         QJsonObject obj;
-        obj[kEmbeddingDBMetaDataTableSource] = source;
-        obj[kEmbeddingDBMetaDataTableContent] = content;
-        obj[kSearchResultDistance] = static_cast<double>(dumpIt.key());
+        obj[kEmbeddingDBMetaDataTableSource] = data.first;
+        obj[kEmbeddingDBMetaDataTableContent] = data.second;
+        obj[kSearchResultDistance] = static_cast<double>(res.distance);
         resultArray.append(obj);
-        sort++;
-        j++;
     }
-    resultObj["result"] = resultArray;
-    qDebug() << QString::fromUtf8(QJsonDocument(resultObj).toJson(QJsonDocument::Compact));
-    return QJsonDocument(resultObj).toJson(QJsonDocument::Compact);
+
+    return resultArray;
 }
 
 void Embedding::deleteCacheIndex(const QStringList &files)
@@ -538,29 +533,37 @@ void Embedding::deleteCacheIndex(const QStringList &files)
 
 bool Embedding::doIndexDump(faiss::idx_t startID, faiss::idx_t endID)
 {
-    QMutexLocker lk(&embeddingMutex);
-    //插入源信息
+    // 锁内只拼接语句，写库在锁外进行，检索期间仍能从缓存取到文本；写库成功后再移出缓存
     QStringList insertSqlstrs;
-    for (faiss::idx_t id = startID; id <= endID; id++) {
-        if (!embedDataCache.contains(id))
-            continue;
-
-        QString queryStr = "INSERT INTO embedding_metadata (id, source, content) VALUES ("
-                + QString::number(id) + ", '" + embedDataCache.value(id).first + "', " + "'" + embedDataCache.value(id).second + "')";
-        insertSqlstrs << queryStr;
+    QVector<faiss::idx_t> dumpedIDs;
+    {
+        QMutexLocker lk(&embeddingMutex);
+        //插入源信息
+        for (faiss::idx_t id = startID; id <= endID; id++) {
+            if (!embedDataCache.contains(id))
+                continue;
 
-        embedDataCache.remove(id);
-        embedVectorCache.remove(id);
+            QString queryStr = "INSERT INTO embedding_metadata (id, source, content) VALUES ("
+                    + QString::number(id) + ", '" + embedDataCache.value(id).first + "', " + "'" + embedDataCache.value(id).second + "')";
+            insertSqlstrs << queryStr;
+            dumpedIDs << id;
+        }
     }
 
+    // 上次段文件写出失败退回内存的向量，元数据已写库，只需重新落盘索引
     if (insertSqlstrs.isEmpty())
-        return false;
+        return true;
 
     if (!batchInsertDataToDB(insertSqlstrs)) {
         qWarning() << "Insert DB failed.";
         return false;
     }
 
+    QMutexLocker lk(&embeddingMutex);
+    for (faiss::idx_t id : dumpedIDs) {
+        embedDataCache.remove(id);
+        embedVectorCache.remove(id);
+    }
     return true;
 }
 
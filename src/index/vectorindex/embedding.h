@@ -5,7 +5,10 @@
 #ifndef EMBEDDING_H
 #define EMBEDDING_H
 
+#include "topkheap.h"
+
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QObject>
 #include <QVector>
 #include <QHash>
@@ -16,7 +19,17 @@
 
 #include <faiss/Index.h>
 
-typedef QJsonObject (*embeddingApi)(const QStringList &texts, void *user);
+// 返回模型服务 /embeddings 的原始响应，由 EmbeddingDecoder 解析
+typedef QByteArray (*embeddingApi)(const QStringList &texts, void *user);
+
+// 入库流水线中的文档：解析分块后向量化，最后写入缓存
+struct IngestDocument
+{
+    QString file;       // 原文档
+    QString source;     // 入库的文档路径，另存时为副本路径
+    QStringList chunks;
+    QVector<QVector<float>> vectors;
+};
 
 class Embedding : public QObject
 {
@@ -26,22 +39,26 @@ public:
 
     bool embeddingDocument(const QString &docFilePath);
     bool embeddingDocumentSaveAs(const QString &docFilePath);
+    bool prepareDocument(const QString &docFilePath, bool saveAs, IngestDocument &doc);
+    bool appendDocument(const IngestDocument &doc);
     QVector<QVector<float>> embeddingTexts(const QStringList &texts);
     void embeddingQuery(const QString &query, QVector<float> &queryVector);
+    QVector<QVector<float>> embeddingQueries(const QStringList &queries);
 
     //DB operate
     bool batchInsertDataToDB(const QStringList &inserQuery);
     int getDBLastID();
     void createEmbedDataTable();
     bool isDupDocument(const QString &docFilePath);
+    bool isCacheDocument(const QString &source);
 
     void embeddingClear();
 
     QMap<faiss::idx_t, QVector<float>> getEmbedVectorCache();
     QMap<faiss::idx_t, QPair<QString, QString>> getEmbedDataCache();
 
-    QString loadTextsFromSearch(int topK, const QMap<float, faiss::idx_t> &cacheSearchRes,
-                                    const QMap<float, faiss::idx_t> &dumpSearchRes);
+    QString loadTextsFromSearch(int topK, const QVector<SearchResult> &searchResults);
+    QString loadTextsFromSearch(int topK, const QVector<QVector<SearchResult>> &searchResults);
 
     inline static QString workerDir()
     {
@@ -55,14 +72,22 @@ public:
         apiData = user;
     }
 
+    // 检索读元数据使用的连接，默认与入库共用
+    inline void setQueryDatabase(QSqlDatabase *db, QMutex *mtx) {
+        queryDataBase = db;
+        queryDbMtx = mtx;
+    }
+
     void deleteCacheIndex(const QStringList &files);
     bool doIndexDump(faiss::idx_t startID, faiss::idx_t endID);
     bool doSaveAsDoc(const QString &file);
     bool doDeleteSaveAsDoc(const QStringList &files);
 private:
-    QStringList textsSpliter(QString &texts);
-    void textsSplitSize(const QString &text, QStringList &splits, QString &over, int pos = 0);
+    QJsonArray loadResultsFromSearch(int topK, const QVector<SearchResult> &searchResults);
     QPair<QString, QString> getDataCacheFromID(const faiss::idx_t &id);
+    bool getDataFromDB(const faiss::idx_t &id, QPair<QString, QString> &data);
+    void loadReadOnlyData();
+    void normalizeVector(QVector<float> &vector);
     QString saveAsDocPath(const QString &doc);
 
     embeddingApi onHttpEmbedding = nullptr;
@@ -71,12 +96,22 @@ private:
     QMap<faiss::idx_t, QPair<QString, QString>> embedDataCache;
     QMap<faiss::idx_t, QVector<float>> embedVectorCache;
 
+    // 只读知识库的全部元数据，首次检索时载入
+    QHash<faiss::idx_t, QPair<QString, QString>> readOnlyData;
+    bool readOnlyDataLoaded = false;
+    QMutex readOnlyDataMtx;
+
     QSqlDatabase *dataBase = nullptr;
     QMutex *dbMtx = nullptr;
+    QSqlDatabase *queryDataBase = nullptr;
+    QMutex *queryDbMtx = nullptr;
 
     QMutex embeddingMutex;
 
     QString appID;
+    faiss::MetricType metric = faiss::METRIC_L2;
+    int chunkOverlap = 0;
+    QString chunkDelimiters;
 };
 
 #endif // EMBEDDING_H
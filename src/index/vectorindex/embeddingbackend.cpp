@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "embeddingbackend.h"
+#include "embeddingdecoder.h"
+#include "../global_define.h"
+#include "config/configmanager.h"
+
+#ifdef ENABLE_ONNX_EMBEDDING
+#include "onnxembeddingbackend.h"
+#endif
+
+#include <QVector>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+static inline quint32 mixHash(quint32 h)
+{
+    // murmur3 的 fmix32，使相邻字符码分散到各维
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+EmbeddingBackend::~EmbeddingBackend()
+{
+}
+
+QByteArray EmbeddingBackend::embeddingApi(const QStringList &texts, void *user)
+{
+    EmbeddingBackend *backend = static_cast<EmbeddingBackend *>(user);
+    if (!backend || !backend->isAvailable())
+        return {};
+    return backend->embed(texts);
+}
+
+EmbeddingBackend *EmbeddingBackend::create(const QString &name)
+{
+    if (name == "stub")
+        return new StubEmbeddingBackend(EmbeddingDim);
+
+    if (name == "onnx") {
+#ifdef ENABLE_ONNX_EMBEDDING
+        const QString modelPath = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_MODEL_PATH,
+                                                          QString()).toString();
+        const int threads = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_THREADS, 0).toInt();
+        return new OnnxEmbeddingBackend(modelPath, threads);
+#else
+        qWarning() << "embedding backend onnx is not built in, use modelhub";
+#endif
+    }
+
+    return nullptr;
+}
+
+StubEmbeddingBackend::StubEmbeddingBackend(int dim)
+    : dim(qMax(1, dim))
+{
+}
+
+QString StubEmbeddingBackend::model() const
+{
+    return QString("stub-%0").arg(dim);
+}
+
+bool StubEmbeddingBackend::isAvailable()
+{
+    return true;
+}
+
+QByteArray StubEmbeddingBackend::embed(const QStringList &texts)
+{
+    QVector<float> vectors(texts.size() * dim);
+    for (int i = 0; i < texts.size(); i++)
+        embedText(texts[i], vectors.data() + i * dim);
+    return EmbeddingDecoder::encodeBinary(vectors.constData(), texts.size(), dim);
+}
+
+void StubEmbeddingBackend::embedText(const QString &text, float *vector) const
+{
+    std::fill(vector, vector + dim, 0.f);
+
+    const ushort *data = text.utf16();
+    for (int i = 0; i < text.size(); i++) {
+        // 一元组权重 1，二元组权重 2，以符号位区分正负，减少哈希冲突的累积偏差
+        quint32 h = mixHash(data[i]);
+        vector[h % static_cast<quint32>(dim)] += (h & 0x80000000u) ? -1.f : 1.f;
+        if (i + 1 < text.size()) {
+            h = mixHash((static_cast<quint32>(data[i]) << 16) | data[i + 1]);
+            vector[h % static_cast<quint32>(dim)] += (h & 0x80000000u) ? -2.f : 2.f;
+        }
+    }
+
+    double norm = 0;
+    for (int j = 0; j < dim; j++)
+        norm += static_cast<double>(vector[j]) * vector[j];
+    if (norm <= 0) {
+        vector[0] = 1.f;
+        return;
+    }
+
+    const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (int j = 0; j < dim; j++)
+        vector[j] *= scale;
+}
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef EMBEDDINGBACKEND_H
+#define EMBEDDINGBACKEND_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// 进程内的向量化后端，经 embeddingApi 函数指针接入 Embedding，替代 modelhub 的 HTTP 调用
+// 返回值与模型服务的响应一样交给 EmbeddingDecoder 解析，进程内后端直接返回二进制帧
+class EmbeddingBackend
+{
+public:
+    virtual ~EmbeddingBackend();
+
+    // 模型标识，用作查询与文本块向量缓存的键
+    virtual QString model() const = 0;
+    virtual bool isAvailable() = 0;
+    // 失败时返回空
+    virtual QByteArray embed(const QStringList &texts) = 0;
+
+    // 适配 embeddingApi，user 为 EmbeddingBackend 指针
+    static QByteArray embeddingApi(const QStringList &texts, void *user);
+
+    // 按名称创建：stub / onnx；modelhub 或未编译的后端返回 nullptr
+    static EmbeddingBackend *create(const QString &name);
+};
+
+// 确定性的桩后端：字符一元、二元组特征哈希到 dim 维后归一化，
+// 相同文本得到相同向量，字面相近的文本向量相近；不依赖模型服务，用于联调与性能测试
+class StubEmbeddingBackend : public EmbeddingBackend
+{
+public:
+    explicit StubEmbeddingBackend(int dim);
+
+    QString model() const override;
+    bool isAvailable() override;
+    QByteArray embed(const QStringList &texts) override;
+
+    void embedText(const QString &text, float *vector) const;
+
+private:
+    int dim = 0;
+};
+
+#endif // EMBEDDINGBACKEND_H
@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "embeddingbatcher.h"
+#include "config/configmanager.h"
+
+#include <QDebug>
+
+static constexpr int kDefaultEmbedCharBudget { 4500 };   // 约 15 个 300 字的分块
+static constexpr int kMinEmbedCharBudget { 300 };
+static constexpr int kMaxEmbedCharBudget { 32768 };
+static constexpr int kEmbedBudgetStep { 600 };   // 加性增大的步长
+static constexpr int kDefaultEmbedMaxItems { 64 };
+static constexpr qint64 kDefaultEmbedTargetLatency { 3000 };   // ms
+static constexpr int kDefaultEmbedMaxInFlight { 2 };
+static constexpr double kEmbedStatsAlpha { 0.2 };   // 滑动平均系数
+
+EmbeddingBatcher *EmbeddingBatcher::instance()
+{
+    static EmbeddingBatcher ins;
+    return &ins;
+}
+
+EmbeddingBatcher::EmbeddingBatcher()
+    : inFlight(qMax(1, ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_MAX_IN_FLIGHT,
+                                               kDefaultEmbedMaxInFlight).toInt()))
+{
+    minBudget = kMinEmbedCharBudget;
+    maxBudget = qMax(minBudget, ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_MAX_CHARS,
+                                                        kMaxEmbedCharBudget).toInt());
+    charBudget = qBound(minBudget, kDefaultEmbedCharBudget, maxBudget);
+    maxItems = qMax(1, ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_MAX_ITEMS,
+                                               kDefaultEmbedMaxItems).toInt());
+    targetLatency = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_TARGET_LATENCY,
+                                            kDefaultEmbedTargetLatency).toLongLong();
+}
+
+int EmbeddingBatcher::nextBatchSize(const QStringList &texts, int start)
+{
+    int budget = 0;
+    {
+        QMutexLocker lk(&mtx);
+        budget = charBudget;
+    }
+
+    // 超出预算的单个长文本单独成批
+    int count = 0;
+    int chars = 0;
+    for (int i = start; i < texts.size() && count < maxItems; i++) {
+        chars += texts[i].size();
+        if (count > 0 && chars > budget)
+            break;
+        count++;
+    }
+    return qMax(1, count);
+}
+
+void EmbeddingBatcher::report(int items, int chars, qint64 latencyMs, bool ok)
+{
+    QMutexLocker lk(&mtx);
+    batchCount++;
+    lastBatchSize = items;
+    lastLatency = latencyMs;
+    avgBatchSize = batchCount == 1 ? items : avgBatchSize + kEmbedStatsAlpha * (items - avgBatchSize);
+    avgLatency = batchCount == 1 ? latencyMs : avgLatency + kEmbedStatsAlpha * (latencyMs - avgLatency);
+
+    if (!ok || latencyMs > targetLatency) {
+        // 超时或失败时预算减半
+        if (!ok)
+            failedCount++;
+        charBudget = qMax(minBudget, charBudget / 2);
+    } else {
+        const double current = latencyMs > 0 ? chars * 1000.0 / latencyMs : 0;
+        throughput = throughput <= 0 ? current : throughput + kEmbedStatsAlpha * (current - throughput);
+        // 只有装满预算的批次说明预算不足，才继续增大：再放一个平均长度的文本即超出预算
+        // 文档末尾的零头批次、按条数上限截断的批次不算装满
+        const int avgItem = items > 0 ? chars / items : 0;
+        if (items < maxItems && chars + avgItem > charBudget)
+            charBudget = qMin(maxBudget, charBudget + kEmbedBudgetStep);
+    }
+
+    qDebug() << "embedding batch:" << items << "texts" << chars << "chars" << latencyMs << "ms"
+             << (ok ? "ok" : "failed") << "next budget" << charBudget;
+}
+
+void EmbeddingBatcher::acquire()
+{
+    inFlight.acquire();
+}
+
+void EmbeddingBatcher::release()
+{
+    inFlight.release();
+}
+
+QVariantHash EmbeddingBatcher::stats()
+{
+    QMutexLocker lk(&mtx);
+    QVariantHash hash;
+    hash.insert("charBudget", charBudget);
+    hash.insert("batches", batchCount);
+    hash.insert("failedBatches", failedCount);
+    hash.insert("lastBatchSize", lastBatchSize);
+    hash.insert("lastLatencyMs", lastLatency);
+    hash.insert("avgBatchSize", avgBatchSize);
+    hash.insert("avgLatencyMs", avgLatency);
+    hash.insert("charsPerSecond", throughput);
+    return hash;
+}
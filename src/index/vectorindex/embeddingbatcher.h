@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef EMBEDDINGBATCHER_H
+#define EMBEDDINGBATCHER_H
+
+#include <QMutex>
+#include <QSemaphore>
+#include <QStringList>
+#include <QVariantHash>
+
+#define EmbeddingBatcherIns EmbeddingBatcher::instance()
+
+// 向量化请求的自适应分批：按字符预算装箱，根据服务延迟加性增大、乘性减小预算，
+// 并限制同时发往模型服务的请求数；模型服务为各应用共享，故为单例
+class EmbeddingBatcher
+{
+public:
+    static EmbeddingBatcher *instance();
+
+    // 从 start 开始，本批可装入的文本个数，至少为 1
+    int nextBatchSize(const QStringList &texts, int start);
+    void report(int items, int chars, qint64 latencyMs, bool ok);
+
+    void acquire();
+    void release();
+
+    QVariantHash stats();
+
+private:
+    explicit EmbeddingBatcher();
+
+    int charBudget = 0;
+    int minBudget = 0;
+    int maxBudget = 0;
+    int maxItems = 0;
+    qint64 targetLatency = 0;
+
+    qint64 batchCount = 0;
+    qint64 failedCount = 0;
+    int lastBatchSize = 0;
+    qint64 lastLatency = 0;
+    double avgBatchSize = 0;
+    double avgLatency = 0;
+    double throughput = 0;   // 字符/秒
+
+    QSemaphore inFlight;
+    QMutex mtx;
+};
+
+#endif // EMBEDDINGBATCHER_H
@@ -0,0 +1,512 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "embeddingdecoder.h"
+
+#include <QtEndian>
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+static constexpr int kMaxMantissaDigits { 19 };   // quint64 可容纳的十进制有效位数
+static constexpr char kBinaryMagic[] { "EMBB" };
+static constexpr int kBinaryHeaderSize { 16 };
+static constexpr quint32 kBinaryFloat32 { 0 };
+static constexpr quint32 kBinaryFloat16 { 1 };
+
+static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// 只识别响应中用到的 JSON 结构，其余字段整体跳过
+class Scanner
+{
+public:
+    Scanner(const char *begin, const char *end)
+        : p(begin), end(end) {}
+
+    void skipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            ++p;
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (p < end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    // 读取对象的键并与 name 比较，键中不会出现转义字符
+    bool readKey(const char *name, bool &matched)
+    {
+        if (!consume('"'))
+            return false;
+
+        const char *begin = p;
+        if (!skipString())
+            return false;
+
+        const size_t len = static_cast<size_t>(p - 1 - begin);
+        matched = len == strlen(name) && memcmp(begin, name, len) == 0;
+        return consume(':');
+    }
+
+    bool peek(char c)
+    {
+        skipSpace();
+        return p < end && *p == c;
+    }
+
+    // 读取不含转义的字符串内容，如 base64
+    bool readString(const char *&begin, int &len)
+    {
+        if (!consume('"'))
+            return false;
+
+        begin = p;
+        if (!skipString())
+            return false;
+
+        len = static_cast<int>(p - 1 - begin);
+        return true;
+    }
+
+    bool skipValue()
+    {
+        skipSpace();
+        if (p >= end)
+            return false;
+
+        if (*p == '"') {
+            ++p;
+            return skipString();
+        }
+
+        if (*p == '{' || *p == '[') {
+            int depth = 0;
+            while (p < end) {
+                char c = *p++;
+                if (c == '"') {
+                    if (!skipString())
+                        return false;
+                } else if (c == '{' || c == '[') {
+                    depth++;
+                } else if (c == '}' || c == ']') {
+                    if (--depth == 0)
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        // 数字与 true/false/null
+        const char *begin = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ']'
+               && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+            ++p;
+        return p > begin;
+    }
+
+    // 不依赖 locale 的十进制解析，精度先保留在 double 中
+    bool readNumber(float &out)
+    {
+        skipSpace();
+        bool negative = false;
+        if (p < end && *p == '-') {
+            negative = true;
+            ++p;
+        }
+
+        quint64 mantissa = 0;
+        int digits = 0;
+        int exp10 = 0;
+        bool any = false;
+        while (p < end && *p >= '0' && *p <= '9') {
+            any = true;
+            if (digits < kMaxMantissaDigits) {
+                mantissa = mantissa * 10 + static_cast<quint64>(*p - '0');
+                if (mantissa)
+                    digits++;
+            } else {
+                exp10++;
+            }
+            ++p;
+        }
+
+        if (p < end && *p == '.') {
+            ++p;
+            while (p < end && *p >= '0' && *p <= '9') {
+                any = true;
+                if (digits < kMaxMantissaDigits) {
+                    mantissa = mantissa * 10 + static_cast<quint64>(*p - '0');
+                    if (mantissa)
+                        digits++;
+                    exp10--;
+                }
+                ++p;
+            }
+        }
+
+        if (!any)
+            return false;
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool expNegative = false;
+            if (p < end && (*p == '+' || *p == '-'))
+                expNegative = *p++ == '-';
+
+            int exponent = 0;
+            bool expAny = false;
+            while (p < end && *p >= '0' && *p <= '9') {
+                expAny = true;
+                if (exponent < 10000)
+                    exponent = exponent * 10 + (*p - '0');
+                ++p;
+            }
+            if (!expAny)
+                return false;
+            exp10 += expNegative ? -exponent : exponent;
+        }
+
+        double value = static_cast<double>(mantissa);
+        if (mantissa != 0 && exp10 != 0) {
+            if (exp10 < 0 && -exp10 <= 22)
+                value /= kPow10[-exp10];
+            else if (exp10 > 0 && exp10 <= 22)
+                value *= kPow10[exp10];
+            else
+                value *= std::pow(10.0, exp10);
+        }
+
+        out = static_cast<float>(negative ? -value : value);
+        return true;
+    }
+
+private:
+    // 调用时已越过起始引号，返回时位于结束引号之后
+    bool skipString()
+    {
+        while (p < end) {
+            char c = *p++;
+            if (c == '\\')
+                ++p;
+            else if (c == '"')
+                return true;
+        }
+        return false;
+    }
+
+    const char *p = nullptr;
+    const char *end = nullptr;
+};
+
+float halfToFloat(quint16 h)
+{
+    quint32 sign = static_cast<quint32>(h & 0x8000) << 16;
+    quint32 exp = (h >> 10) & 0x1f;
+    quint32 mant = h & 0x3ff;
+    quint32 bits = sign;
+    if (exp == 0) {
+        if (mant != 0) {
+            // 非规格化数
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                exp--;
+            }
+            bits |= (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+    } else if (exp == 0x1f) {
+        bits |= 0x7f800000 | (mant << 13);
+    } else {
+        bits |= ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+
+    float f = 0;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+int base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+' || c == '-')
+        return 62;
+    if (c == '/' || c == '_')
+        return 63;
+    return -1;
+}
+
+// 直接解码到 buffer 末尾，不产生中间的 QByteArray
+bool appendBase64(const char *begin, int len, QVector<float> &buffer)
+{
+    const int start = buffer.size();
+    buffer.resize(start + len * 3 / 4 / static_cast<int>(sizeof(float)) + 1);
+    uchar *out = reinterpret_cast<uchar *>(buffer.data() + start);
+
+    quint32 acc = 0;
+    int bits = 0;
+    int bytes = 0;
+    for (int i = 0; i < len; i++) {
+        const char c = begin[i];
+        if (c == '=')
+            break;
+        if (c == '\\')   // 部分服务会把 '/' 转义为 "\/"
+            continue;
+
+        int v = base64Value(c);
+        if (v < 0)
+            return false;
+
+        acc = (acc << 6) | static_cast<quint32>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[bytes++] = static_cast<uchar>((acc >> bits) & 0xff);
+        }
+    }
+
+    if (bytes % sizeof(float))
+        return false;
+
+    const int count = bytes / static_cast<int>(sizeof(float));
+    buffer.resize(start + count);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for (int i = start; i < buffer.size(); i++) {
+        quint32 v = qFromLittleEndian<quint32>(buffer.constData() + i);
+        memcpy(buffer.data() + i, &v, sizeof(v));
+    }
+#endif
+    return true;
+}
+
+int decodeBinary(const QByteArray &response, QVector<float> &buffer, int &dim)
+{
+    if (response.size() < kBinaryHeaderSize)
+        return -1;
+
+    const uchar *head = reinterpret_cast<const uchar *>(response.constData());
+    const quint32 rows = qFromLittleEndian<quint32>(head + 4);
+    const quint32 cols = qFromLittleEndian<quint32>(head + 8);
+    const quint32 dtype = qFromLittleEndian<quint32>(head + 12);
+    if (dtype != kBinaryFloat32 && dtype != kBinaryFloat16)
+        return -1;
+
+    const qint64 width = dtype == kBinaryFloat16 ? 2 : 4;
+    const qint64 total = static_cast<qint64>(rows) * cols;
+    if (total > INT_MAX || response.size() != kBinaryHeaderSize + total * width)
+        return -1;
+
+    buffer.resize(static_cast<int>(total));
+    const uchar *data = head + kBinaryHeaderSize;
+    if (dtype == kBinaryFloat32) {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        memcpy(buffer.data(), data, static_cast<size_t>(total * width));
+#else
+        for (int i = 0; i < buffer.size(); i++) {
+            quint32 v = qFromLittleEndian<quint32>(data + i * 4);
+            memcpy(buffer.data() + i, &v, sizeof(v));
+        }
+#endif
+    } else {
+        for (int i = 0; i < buffer.size(); i++)
+            buffer[i] = halfToFloat(qFromLittleEndian<quint16>(data + i * 2));
+    }
+
+    dim = static_cast<int>(cols);
+    return static_cast<int>(rows);
+}
+
+bool readVector(Scanner &s, int expected, QVector<float> &buffer, int &dim)
+{
+    const int start = buffer.size();
+    if (s.peek('"')) {
+        const char *begin = nullptr;
+        int len = 0;
+        if (!s.readString(begin, len) || !appendBase64(begin, len, buffer))
+            return false;
+    } else if (!s.consume('[')) {
+        return false;
+    } else if (!s.consume(']')) {
+        do {
+            float value = 0;
+            if (!s.readNumber(value))
+                return false;
+            buffer.append(value);
+        } while (s.consume(','));
+
+        if (!s.consume(']'))
+            return false;
+    }
+
+    const int count = buffer.size() - start;
+    if (dim < 0) {
+        // 第一个向量确定维度后一次分配全部空间
+        dim = count;
+        buffer.reserve(qMax(expected, 1) * dim);
+    }
+    return count == dim;
+}
+
+bool readItem(Scanner &s, int expected, QVector<float> &buffer, int &dim)
+{
+    if (!s.consume('{'))
+        return false;
+
+    bool found = false;
+    if (!s.consume('}')) {
+        do {
+            bool matched = false;
+            if (!s.readKey("embedding", matched))
+                return false;
+
+            if (matched && !found) {
+                if (!readVector(s, expected, buffer, dim))
+                    return false;
+                found = true;
+            } else if (!s.skipValue()) {
+                return false;
+            }
+        } while (s.consume(','));
+
+        if (!s.consume('}'))
+            return false;
+    }
+    return found;
+}
+
+int readData(Scanner &s, int expected, QVector<float> &buffer, int &dim)
+{
+    if (!s.consume('['))
+        return -1;
+
+    int rows = 0;
+    if (s.consume(']'))
+        return rows;
+
+    do {
+        if (!readItem(s, expected, buffer, dim))
+            return -1;
+        rows++;
+    } while (s.consume(','));
+
+    return s.consume(']') ? rows : -1;
+}
+
+}   // namespace
+
+EmbeddingDecoder::Encoding EmbeddingDecoder::encoding(const QByteArray &response)
+{
+    if (response.startsWith(kBinaryMagic)) {
+        if (response.size() >= kBinaryHeaderSize
+                && qFromLittleEndian<quint32>(response.constData() + 12) == kBinaryFloat16)
+            return BinaryFp16;
+        return Binary;
+    }
+
+    int pos = response.indexOf("\"embedding\"");
+    if (pos < 0)
+        return Float;
+
+    pos = response.indexOf(':', pos);
+    while (pos >= 0 && ++pos < response.size()) {
+        const char c = response.at(pos);
+        if (c == '"')
+            return Base64;
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            break;
+    }
+    return Float;
+}
+
+int EmbeddingDecoder::decode(const QByteArray &response, int expected, QVector<float> &buffer, int &dim)
+{
+    buffer.clear();
+    dim = -1;
+
+    if (response.startsWith(kBinaryMagic))
+        return decodeBinary(response, buffer, dim);
+
+    Scanner s(response.constData(), response.constData() + response.size());
+    if (!s.consume('{'))
+        return -1;
+
+    int rows = -1;
+    if (!s.consume('}')) {
+        do {
+            bool matched = false;
+            if (!s.readKey("data", matched))
+                return -1;
+
+            if (matched && rows < 0) {
+                rows = readData(s, expected, buffer, dim);
+                if (rows < 0)
+                    return -1;
+            } else if (!s.skipValue()) {
+                return -1;
+            }
+        } while (s.consume(','));
+
+        if (!s.consume('}'))
+            return -1;
+    }
+
+    if (dim < 0)
+        dim = 0;
+    return rows;
+}
+
+bool EmbeddingDecoder::decode(const QByteArray &response, int expected, QVector<QVector<float>> &vectors)
+{
+    QVector<float> buffer;
+    int dim = 0;
+    int rows = decode(response, expected, buffer, dim);
+    if (rows != expected)
+        return false;
+
+    vectors.resize(rows);
+    for (int i = 0; i < rows; i++) {
+        vectors[i].resize(dim);
+        memcpy(vectors[i].data(), buffer.constData() + i * dim, sizeof(float) * static_cast<size_t>(dim));
+    }
+    return true;
+}
+
+QByteArray EmbeddingDecoder::encodeBinary(const float *vectors, int rows, int dim)
+{
+    const int count = qMax(0, rows) * qMax(0, dim);
+    QByteArray frame(kBinaryHeaderSize + count * 4, Qt::Uninitialized);
+    uchar *head = reinterpret_cast<uchar *>(frame.data());
+    memcpy(head, kBinaryMagic, 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(qMax(0, rows)), head + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(qMax(0, dim)), head + 8);
+    qToLittleEndian<quint32>(kBinaryFloat32, head + 12);
+
+    uchar *data = head + kBinaryHeaderSize;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    memcpy(data, vectors, static_cast<size_t>(count) * 4);
+#else
+    for (int i = 0; i < count; i++) {
+        quint32 bits = 0;
+        memcpy(&bits, vectors + i, sizeof(bits));
+        qToLittleEndian<quint32>(bits, data + i * 4);
+    }
+#endif
+    return frame;
+}
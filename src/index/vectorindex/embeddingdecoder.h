@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef EMBEDDINGDECODER_H
+#define EMBEDDINGDECODER_H
+
+#include <QByteArray>
+#include <QVector>
+
+// 解析模型服务 /embeddings 的响应 {"data":[{"embedding":[...]}, ...]}
+// 只扫描一遍响应字节，浮点数直接写入连续缓冲区，不经过 QJsonDocument
+// embedding 也可以是 base64 编码的小端 float32；或整个响应为二进制帧(小端)：
+// "EMBB" | uint32 rows | uint32 dim | uint32 dtype(0 float32, 1 float16) | rows * dim 个元素
+class EmbeddingDecoder
+{
+public:
+    enum Encoding {
+        Float = 0,   // JSON 数组
+        Base64,      // 同 OpenAI encoding_format=base64
+        Binary,
+        BinaryFp16
+    };
+
+    // 响应实际使用的编码，用于和模型服务协商
+    static Encoding encoding(const QByteArray &response);
+
+    // 按行写入 buffer，expected 用于预分配；返回向量个数，格式错误或各向量维度不一致时返回 -1
+    static int decode(const QByteArray &response, int expected, QVector<float> &buffer, int &dim);
+
+    // 向量个数不等于 expected 时返回 false
+    static bool decode(const QByteArray &response, int expected, QVector<QVector<float>> &vectors);
+
+    // 打包为 float32 二进制帧，供进程内的向量化后端直接返回
+    static QByteArray encodeBinary(const float *vectors, int rows, int dim);
+};
+
+#endif // EMBEDDINGDECODER_H
@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "fileeventqueue.h"
+#include "config/configmanager.h"
+
+#include <QTimer>
+
+static constexpr int kDefaultWatchDebounce { 2000 };   // ms
+static constexpr int kMaxDelayFactor { 10 };   // 最长等待为防抖窗口的倍数
+
+FileEventQueue::FileEventQueue(const Filter &filter, const Dispatcher &dispatcher, QObject *parent)
+    : QObject(parent),
+      filter(filter),
+      dispatcher(dispatcher)
+{
+    debounce = qMax(0, ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_WATCH_DEBOUNCE,
+                                               kDefaultWatchDebounce).toInt());
+    maxDelay = debounce * kMaxDelayFactor;
+    clock.start();
+}
+
+void FileEventQueue::pushCreated(const QString &file)
+{
+    push(file, true);
+}
+
+void FileEventQueue::pushDeleted(const QString &file)
+{
+    push(file, false);
+}
+
+void FileEventQueue::clear()
+{
+    QMutexLocker lk(&mtx);
+    pending.clear();
+}
+
+QVariantHash FileEventQueue::stats() const
+{
+    QMutexLocker lk(&mtx);
+    QVariantHash hash;
+    hash.insert("pending", pending.size());
+    hash.insert("received", received);
+    hash.insert("dropped", dropped);
+    hash.insert("merged", merged);
+    hash.insert("dispatched", dispatched);
+    hash.insert("batches", batches);
+    return hash;
+}
+
+void FileEventQueue::push(const QString &file, bool created)
+{
+    // 过滤在监视线程完成，不支持的文件不跨线程
+    if (filter && !filter(file)) {
+        QMutexLocker lk(&mtx);
+        received++;
+        dropped++;
+        return;
+    }
+
+    QMutexLocker lk(&mtx);
+    received++;
+    if (pending.contains(file))
+        merged++;
+    pending.insert(file, created);
+
+    lastEvent = clock.elapsed();
+    if (scheduled)
+        return;
+
+    // 每轮只投递一次，之后的事件只更新时间
+    scheduled = true;
+    firstEvent = lastEvent;
+    QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+}
+
+void FileEventQueue::flush()
+{
+    QStringList created;
+    QStringList deleted;
+    {
+        QMutexLocker lk(&mtx);
+        if (pending.isEmpty()) {
+            scheduled = false;
+            return;
+        }
+
+        const qint64 now = clock.elapsed();
+        const qint64 quiet = lastEvent + debounce - now;
+        const qint64 deadline = firstEvent + maxDelay - now;
+        if (quiet > 0 && deadline > 0) {
+            QTimer::singleShot(static_cast<int>(qMin(quiet, deadline)), this, &FileEventQueue::flush);
+            return;
+        }
+
+        for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+            if (it.value())
+                created << it.key();
+            else
+                deleted << it.key();
+        }
+        pending.clear();
+        scheduled = false;
+        dispatched += created.size() + deleted.size();
+        batches++;
+    }
+
+    dispatcher(created, deleted);
+}
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef FILEEVENTQUEUE_H
+#define FILEEVENTQUEUE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QVariantHash>
+
+#include <functional>
+
+// 文件监视事件的合并队列：在监视线程内按过滤条件丢弃无关文件，同一路径的多次事件只保留最终状态
+// (新建、删除、重命名先后发生时以最后一次为准)；防抖窗口内没有新事件后，在队列所属线程一次性分发
+// 事件持续不断时，最早的事件等待超过上限也会分发
+class FileEventQueue : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<bool(const QString &file)> Filter;
+    typedef std::function<void(const QStringList &created, const QStringList &deleted)> Dispatcher;
+
+    explicit FileEventQueue(const Filter &filter, const Dispatcher &dispatcher, QObject *parent = nullptr);
+
+    // 可在任意线程调用
+    void pushCreated(const QString &file);
+    void pushDeleted(const QString &file);
+    void clear();
+
+    QVariantHash stats() const;
+
+private Q_SLOTS:
+    void flush();
+
+private:
+    void push(const QString &file, bool created);
+
+    Filter filter;
+    Dispatcher dispatcher;
+    int debounce = 0;   // ms
+    int maxDelay = 0;   // ms
+
+    mutable QMutex mtx;
+    QHash<QString, bool> pending;   // 路径 -> 最终是否存在
+    bool scheduled = false;
+    QElapsedTimer clock;
+    qint64 firstEvent = 0;
+    qint64 lastEvent = 0;
+
+    qint64 received = 0;
+    qint64 dropped = 0;
+    qint64 merged = 0;
+    qint64 dispatched = 0;
+    qint64 batches = 0;
+};
+
+#endif // FILEEVENTQUEUE_H
@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ingestpipeline.h"
+#include "embeddingbatcher.h"
+#include "lanescheduler.h"
+#include "config/configmanager.h"
+
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+static constexpr int kDefaultIngestQueueSize { 16 };   // 每级队列容纳的文档数
+static constexpr int kDefaultEmbedConcurrency { 2 };   // 同时发往模型服务的请求数
+static constexpr unsigned long kIngestPollInterval { 50 };   // ms
+
+IngestPipeline::IngestPipeline(Embedding *embedder, bool saveAs, const Writer &writer)
+    : embedder(embedder)
+    , saveAs(saveAs)
+    , writer(writer)
+    , fileQueue(ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_INGEST_QUEUE_SIZE,
+                                        kDefaultIngestQueueSize).toInt())
+    , parsedQueue(ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_INGEST_QUEUE_SIZE,
+                                          kDefaultIngestQueueSize).toInt())
+    , embeddedQueue(ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_INGEST_QUEUE_SIZE,
+                                            kDefaultIngestQueueSize).toInt())
+{
+    Q_ASSERT(embedder);
+
+    // 解析为 CPU 密集，占用一半核心；向量化主要等待模型服务
+    parseThreads = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_INGEST_PARSE_THREADS,
+                                           qMax(1, QThread::idealThreadCount() / 2)).toInt();
+    parseThreads = qMax(1, parseThreads);
+    embedConcurrency = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_INGEST_EMBED_CONCURRENCY,
+                                               kDefaultEmbedConcurrency).toInt();
+    embedConcurrency = qMax(1, embedConcurrency);
+
+    parsePool.setMaxThreadCount(parseThreads);
+    embedPool.setMaxThreadCount(embedConcurrency);
+}
+
+IngestPipeline::~IngestPipeline()
+{
+    cancel();
+}
+
+void IngestPipeline::submit(const QString &file)
+{
+    start();
+
+    while (!fileQueue.tryPush(file, kIngestPollInterval))
+        drain();
+
+    drain();
+}
+
+void IngestPipeline::finish()
+{
+    if (!running)
+        return;
+
+    fileQueue.close();
+    while (!embeddedQueue.isDrained())
+        drain(kIngestPollInterval);
+
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+    futures.clear();
+    running = false;
+
+    qInfo() << "ingest pipeline finished:" << stats();
+}
+
+void IngestPipeline::cancel()
+{
+    // 已在途的文档不再向量化，也不写入
+    cancelled = true;
+    finish();
+    cancelled = false;
+}
+
+QVariantHash IngestPipeline::stats() const
+{
+    QVariantHash hash;
+    hash.insert("parsedFiles", static_cast<qint64>(parseStats.items));
+    hash.insert("parseMs", static_cast<qint64>(parseStats.busyMs));
+    hash.insert("embeddedChunks", static_cast<qint64>(embedStats.items));
+    hash.insert("embedMs", static_cast<qint64>(embedStats.busyMs));
+    hash.insert("indexedFiles", static_cast<qint64>(writeStats.items));
+    hash.insert("indexMs", static_cast<qint64>(writeStats.busyMs));
+    hash.insert("embedBatch", EmbeddingBatcherIns->stats());
+    hash.insert("lanes", LaneSchedulerIns->stats());
+    return hash;
+}
+
+void IngestPipeline::start()
+{
+    if (running)
+        return;
+
+    running = true;
+    fileQueue.reopen();
+    parsedQueue.reopen();
+    embeddedQueue.reopen();
+
+    parseActive = parseThreads;
+    embedActive = embedConcurrency;
+    for (int i = 0; i < parseThreads; i++)
+        futures << QtConcurrent::run(&parsePool, [this]() { parseLoop(); });
+    for (int i = 0; i < embedConcurrency; i++)
+        futures << QtConcurrent::run(&embedPool, [this]() { embedLoop(); });
+}
+
+void IngestPipeline::drain(unsigned long timeoutMs)
+{
+    IngestDocument doc;
+    while (embeddedQueue.tryPop(doc, timeoutMs)) {
+        timeoutMs = 0;
+        if (cancelled)
+            continue;
+
+        QElapsedTimer timer;
+        timer.start();
+        writer(doc);
+        writeStats.items++;
+        writeStats.busyMs += timer.elapsed();
+    }
+}
+
+void IngestPipeline::parseLoop()
+{
+    QString file;
+    while (fileQueue.pop(file)) {
+        IngestDocument doc;
+        doc.file = file;
+        if (!cancelled) {
+            LaneSchedulerIns->yield();
+            QElapsedTimer timer;
+            timer.start();
+            embedder->prepareDocument(file, saveAs, doc);
+            parseStats.items++;
+            parseStats.busyMs += timer.elapsed();
+        }
+
+        parsedQueue.push(doc);
+    }
+
+    // 最后一个解析线程退出后关闭下一级队列
+    if (--parseActive == 0)
+        parsedQueue.close();
+}
+
+void IngestPipeline::embedLoop()
+{
+    IngestDocument doc;
+    while (parsedQueue.pop(doc)) {
+        if (!cancelled && !doc.chunks.isEmpty()) {
+            QElapsedTimer timer;
+            timer.start();
+            doc.vectors = embedder->embeddingTexts(doc.chunks);
+            embedStats.items += doc.chunks.size();
+            embedStats.busyMs += timer.elapsed();
+        }
+
+        embeddedQueue.push(doc);
+    }
+
+    if (--embedActive == 0)
+        embeddedQueue.close();
+}
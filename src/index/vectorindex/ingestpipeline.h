@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef INGESTPIPELINE_H
+#define INGESTPIPELINE_H
+
+#include "embedding.h"
+#include "boundedqueue.h"
+
+#include <QFuture>
+#include <QList>
+#include <QThreadPool>
+#include <QVariantHash>
+
+#include <atomic>
+#include <functional>
+
+// 批量入库流水线：解析分块(CPU 线程池) -> 向量化(多个请求并发) -> 写入(调用线程单写)
+// 各级之间为有界队列，下游处理不过来时上游阻塞
+class IngestPipeline
+{
+public:
+    typedef std::function<void(const IngestDocument &doc)> Writer;
+
+    explicit IngestPipeline(Embedding *embedder, bool saveAs, const Writer &writer);
+    ~IngestPipeline();
+
+    // 仅在写入线程调用：入队时若队列已满，先写入已完成的文档
+    void submit(const QString &file);
+    void finish();
+    void cancel();
+
+    QVariantHash stats() const;
+
+private:
+    struct StageStats
+    {
+        std::atomic<qint64> items { 0 };
+        std::atomic<qint64> busyMs { 0 };
+    };
+
+    void start();
+    void drain(unsigned long timeoutMs = 0);
+    void parseLoop();
+    void embedLoop();
+
+    Embedding *embedder = nullptr;
+    bool saveAs = false;
+    Writer writer;
+
+    BoundedQueue<QString> fileQueue;
+    BoundedQueue<IngestDocument> parsedQueue;
+    BoundedQueue<IngestDocument> embeddedQueue;
+
+    QThreadPool parsePool;
+    QThreadPool embedPool;
+    QList<QFuture<void>> futures;
+    int parseThreads = 1;
+    int embedConcurrency = 1;
+    std::atomic<int> parseActive { 0 };
+    std::atomic<int> embedActive { 0 };
+    std::atomic_bool cancelled { false };
+    bool running = false;
+
+    StageStats parseStats;
+    StageStats embedStats;
+    StageStats writeStats;
+};
+
+#endif // INGESTPIPELINE_H
@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "lanescheduler.h"
+#include "config/configmanager.h"
+
+#include <QElapsedTimer>
+
+static constexpr int kDefaultIngestMaxYield { 2000 };   // ms
+
+static thread_local int queryDepth = 0;
+
+LaneScheduler *LaneScheduler::instance()
+{
+    static LaneScheduler ins;
+    return &ins;
+}
+
+LaneScheduler::LaneScheduler()
+{
+    maxYield = qMax(0, ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_INGEST_MAX_YIELD,
+                                               kDefaultIngestMaxYield).toInt());
+}
+
+LaneScheduler::QueryScope::QueryScope()
+{
+    if (queryDepth++ == 0)
+        LaneSchedulerIns->beginQuery();
+}
+
+LaneScheduler::QueryScope::~QueryScope()
+{
+    if (--queryDepth == 0)
+        LaneSchedulerIns->endQuery();
+}
+
+bool LaneScheduler::inQuery()
+{
+    return queryDepth > 0;
+}
+
+void LaneScheduler::yield()
+{
+    // 检索线程内部不让出，否则会等待自己
+    if (inQuery() || maxYield <= 0)
+        return;
+
+    QMutexLocker lk(&mtx);
+    if (activeQueries == 0)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 remain = maxYield;
+    while (activeQueries > 0 && remain > 0) {
+        idle.wait(&mtx, static_cast<unsigned long>(remain));
+        remain = maxYield - timer.elapsed();
+    }
+
+    yieldCount++;
+    yieldMs += timer.elapsed();
+}
+
+QVariantHash LaneScheduler::stats()
+{
+    QMutexLocker lk(&mtx);
+    QVariantHash hash;
+    hash.insert("activeQueries", activeQueries);
+    hash.insert("queries", queryCount);
+    hash.insert("ingestYields", yieldCount);
+    hash.insert("ingestYieldMs", yieldMs);
+    return hash;
+}
+
+void LaneScheduler::beginQuery()
+{
+    QMutexLocker lk(&mtx);
+    activeQueries++;
+    queryCount++;
+}
+
+void LaneScheduler::endQuery()
+{
+    QMutexLocker lk(&mtx);
+    if (--activeQueries == 0)
+        idle.wakeAll();
+}
@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef LANESCHEDULER_H
+#define LANESCHEDULER_H
+
+#include <QMutex>
+#include <QVariantHash>
+#include <QWaitCondition>
+
+#define LaneSchedulerIns LaneScheduler::instance()
+
+// 检索与批量入库的两路调度：检索在调用线程直接执行，进入时登记为在途；
+// 批量入库在批次边界调用 yield，有检索在途时让出模型服务与索引，单次等待有上限，入库不会饿死
+// 模型服务与 CPU 为各应用共享，故为单例
+class LaneScheduler
+{
+public:
+    static LaneScheduler *instance();
+
+    // 检索期间在栈上持有，可嵌套；持有期间本线程发出的模型请求优先发送
+    class QueryScope
+    {
+    public:
+        QueryScope();
+        ~QueryScope();
+
+    private:
+        Q_DISABLE_COPY(QueryScope)
+    };
+
+    static bool inQuery();
+
+    void yield();
+    QVariantHash stats();
+
+private:
+    explicit LaneScheduler();
+
+    void beginQuery();
+    void endQuery();
+
+    int maxYield = 0;   // ms
+    int activeQueries = 0;
+    qint64 queryCount = 0;
+    qint64 yieldCount = 0;
+    qint64 yieldMs = 0;
+
+    QMutex mtx;
+    QWaitCondition idle;
+};
+
+#endif // LANESCHEDULER_H
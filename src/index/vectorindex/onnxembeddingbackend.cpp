@@ -0,0 +1,284 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifdef ENABLE_ONNX_EMBEDDING
+
+#include "onnxembeddingbackend.h"
+#include "embeddingdecoder.h"
+#include "../global_define.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QDebug>
+
+#include <cmath>
+
+static constexpr int kMaxSequenceLength { 512 };
+static constexpr int kMaxWordChars { 100 };   // 超长的词直接记为 [UNK]
+static constexpr char kVocabFile[] { "vocab.txt" };
+
+static bool isCjk(uint c)
+{
+    return (c >= 0x4E00 && c <= 0x9FFF) || (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x20000 && c <= 0x2A6DF)
+            || (c >= 0x2A700 && c <= 0x2B73F) || (c >= 0x2B740 && c <= 0x2B81F) || (c >= 0x2B820 && c <= 0x2CEAF)
+            || (c >= 0xF900 && c <= 0xFAFF) || (c >= 0x2F800 && c <= 0x2FA1F);
+}
+
+static bool isBertPunct(uint c)
+{
+    // 与 BERT BasicTokenizer 一致：ASCII 中非字母数字的可见字符均视为标点
+    if ((c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) || (c >= 123 && c <= 126))
+        return true;
+    return QChar::isPunct(c);
+}
+
+OnnxEmbeddingBackend::OnnxEmbeddingBackend(const QString &modelDir, int threads)
+    : modelDir(modelDir)
+    , threads(threads > 0 ? threads : qMax(1, QThread::idealThreadCount() / 2))
+{
+}
+
+QString OnnxEmbeddingBackend::model() const
+{
+    return QString("onnx-%0").arg(QFileInfo(modelDir).fileName());
+}
+
+bool OnnxEmbeddingBackend::isAvailable()
+{
+    QMutexLocker lk(&loadMtx);
+    if (!loaded && !failed)
+        failed = !load();
+    return loaded;
+}
+
+QByteArray OnnxEmbeddingBackend::embed(const QStringList &texts)
+{
+    if (texts.isEmpty() || !isAvailable())
+        return {};
+
+    // 批内按最长序列补齐
+    QVector<QVector<qint64>> tokens;
+    tokens.reserve(texts.size());
+    int seqLen = 0;
+    for (const QString &text : texts) {
+        tokens << tokenize(text);
+        seqLen = qMax(seqLen, tokens.last().size());
+    }
+
+    const int batch = texts.size();
+    const size_t total = static_cast<size_t>(batch) * seqLen;
+    std::vector<int64_t> inputIDs(total, padID);
+    std::vector<int64_t> attentionMask(total, 0);
+    std::vector<int64_t> tokenTypeIDs(total, 0);
+    for (int i = 0; i < batch; i++) {
+        for (int j = 0; j < tokens[i].size(); j++) {
+            inputIDs[static_cast<size_t>(i) * seqLen + j] = tokens[i][j];
+            attentionMask[static_cast<size_t>(i) * seqLen + j] = 1;
+        }
+    }
+
+    try {
+        const int64_t shape[] = { batch, seqLen };
+        Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        std::vector<Ort::Value> inputs;
+        std::vector<const char *> names;
+        for (const std::string &name : inputNames) {
+            std::vector<int64_t> *data = nullptr;
+            if (name == "input_ids")
+                data = &inputIDs;
+            else if (name == "attention_mask")
+                data = &attentionMask;
+            else if (name == "token_type_ids")
+                data = &tokenTypeIDs;
+            else
+                continue;
+
+            inputs.push_back(Ort::Value::CreateTensor<int64_t>(memory, data->data(), data->size(), shape, 2));
+            names.push_back(name.c_str());
+        }
+
+        const char *outputNames[] = { outputName.c_str() };
+        std::vector<Ort::Value> outputs = session->Run(Ort::RunOptions { nullptr }, names.data(), inputs.data(),
+                                                       inputs.size(), outputNames, 1);
+
+        // last_hidden_state [batch, seq, hidden] 取 [CLS]；已池化的输出 [batch, hidden] 直接使用
+        const std::vector<int64_t> outShape = outputs[0].GetTensorTypeAndShapeInfo().GetShape();
+        const float *out = outputs[0].GetTensorData<float>();
+        if ((outShape.size() != 3 && outShape.size() != 2) || outShape[0] != batch) {
+            qWarning() << "unexpected onnx embedding output rank" << outShape.size();
+            return {};
+        }
+
+        const int dim = static_cast<int>(outShape.back());
+        const size_t rowStride = outShape.size() == 3 ? static_cast<size_t>(outShape[1]) * dim : dim;
+        if (dim != EmbeddingDim) {
+            qWarning() << "onnx embedding dimension" << dim << "mismatch with index dimension" << EmbeddingDim;
+            return {};
+        }
+
+        QVector<float> vectors(batch * dim);
+        for (int i = 0; i < batch; i++) {
+            const float *row = out + i * rowStride;
+            float *vector = vectors.data() + i * dim;
+            double norm = 0;
+            for (int j = 0; j < dim; j++)
+                norm += static_cast<double>(row[j]) * row[j];
+            const float scale = norm > 0 ? static_cast<float>(1.0 / std::sqrt(norm)) : 0.f;
+            for (int j = 0; j < dim; j++)
+                vector[j] = row[j] * scale;
+        }
+        return EmbeddingDecoder::encodeBinary(vectors.constData(), batch, dim);
+    } catch (const Ort::Exception &e) {
+        qWarning() << "onnx embedding failed:" << e.what();
+    }
+
+    return {};
+}
+
+bool OnnxEmbeddingBackend::load()
+{
+    QString modelPath;
+    for (const QString &name : { QString("model_quantized.onnx"), QString("model.onnx") }) {
+        if (QFile::exists(modelDir + QDir::separator() + name)) {
+            modelPath = modelDir + QDir::separator() + name;
+            break;
+        }
+    }
+
+    if (modelPath.isEmpty() || !loadVocab(modelDir + QDir::separator() + kVocabFile)) {
+        qWarning() << "onnx embedding model is not found in" << modelDir;
+        return false;
+    }
+
+    try {
+        env.reset(new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "deepin-ai-daemon"));
+
+        Ort::SessionOptions options;
+        options.SetIntraOpNumThreads(threads);
+        options.SetInterOpNumThreads(1);
+        options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        session.reset(new Ort::Session(*env, modelPath.toStdString().c_str(), options));
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        inputNames.clear();
+        for (size_t i = 0; i < session->GetInputCount(); i++)
+            inputNames.push_back(session->GetInputNameAllocated(i, allocator).get());
+        outputName = session->GetOutputNameAllocated(0, allocator).get();
+    } catch (const Ort::Exception &e) {
+        qWarning() << "failed to load onnx embedding model" << modelPath << e.what();
+        session.reset();
+        return false;
+    }
+
+    qInfo() << "onnx embedding model loaded" << modelPath << "threads" << threads;
+    loaded = true;
+    return true;
+}
+
+bool OnnxEmbeddingBackend::loadVocab(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    // 每行一个词，行号即 id
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    qint64 id = 0;
+    while (!in.atEnd()) {
+        const QString token = in.readLine().trimmed();
+        if (!token.isEmpty())
+            vocab.insert(token, id);
+        id++;
+    }
+
+    clsID = vocab.value("[CLS]", -1);
+    sepID = vocab.value("[SEP]", -1);
+    padID = vocab.value("[PAD]", 0);
+    unkID = vocab.value("[UNK]", -1);
+    return clsID >= 0 && sepID >= 0 && unkID >= 0;
+}
+
+QVector<qint64> OnnxEmbeddingBackend::tokenize(const QString &text) const
+{
+    // BERT BasicTokenizer：清理控制字符、汉字单独成词、小写并去除重音、按空白与标点切分；再按 WordPiece 切分
+    const QString normalized = text.toLower().normalized(QString::NormalizationForm_D);
+    const QVector<uint> codes = normalized.toUcs4();
+
+    QVector<qint64> ids;
+    ids << clsID;
+    QString word;
+    auto flush = [&]() {
+        if (!word.isEmpty()) {
+            wordPiece(word, ids);
+            word.clear();
+        }
+    };
+
+    for (uint c : codes) {
+        if (ids.size() >= kMaxSequenceLength - 1)
+            break;
+
+        if (c == 0 || c == 0xFFFD || QChar::category(c) == QChar::Mark_NonSpacing)
+            continue;
+        if (QChar::isSpace(c)) {
+            flush();
+            continue;
+        }
+        if (QChar::category(c) == QChar::Other_Control || QChar::category(c) == QChar::Other_Format)
+            continue;
+
+        if (isCjk(c) || isBertPunct(c)) {
+            flush();
+            word = QString::fromUcs4(&c, 1);
+            flush();
+            continue;
+        }
+        word += QString::fromUcs4(&c, 1);
+    }
+    flush();
+
+    if (ids.size() > kMaxSequenceLength - 1)
+        ids.resize(kMaxSequenceLength - 1);
+    ids << sepID;
+    return ids;
+}
+
+void OnnxEmbeddingBackend::wordPiece(const QString &word, QVector<qint64> &ids) const
+{
+    if (word.size() > kMaxWordChars) {
+        ids << unkID;
+        return;
+    }
+
+    // 贪心最长匹配，词内后续片段带 ## 前缀；任一片段无法匹配则整个词记为 [UNK]
+    QVector<qint64> pieces;
+    int start = 0;
+    while (start < word.size()) {
+        int end = word.size();
+        qint64 id = -1;
+        while (start < end) {
+            QString piece = word.mid(start, end - start);
+            if (start > 0)
+                piece.prepend("##");
+            id = vocab.value(piece, -1);
+            if (id >= 0)
+                break;
+            end--;
+        }
+
+        if (id < 0) {
+            ids << unkID;
+            return;
+        }
+        pieces << id;
+        start = end;
+    }
+    ids << pieces;
+}
+
+#endif // ENABLE_ONNX_EMBEDDING
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef ONNXEMBEDDINGBACKEND_H
+#define ONNXEMBEDDINGBACKEND_H
+
+#include "embeddingbackend.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// 基于 ONNX Runtime 的进程内 CPU 后端，加载 BGE 等 BERT 结构的模型(可为 int8 量化模型)
+// 模型目录需包含 model_quantized.onnx 或 model.onnx，以及 WordPiece 词表 vocab.txt
+// 一次调用的文本合并为一个批次推理，取 [CLS] 位置的输出并归一化；算子内部按 threads 并行
+class OnnxEmbeddingBackend : public EmbeddingBackend
+{
+public:
+    OnnxEmbeddingBackend(const QString &modelDir, int threads);
+
+    QString model() const override;
+    bool isAvailable() override;
+    QByteArray embed(const QStringList &texts) override;
+
+private:
+    bool load();
+    bool loadVocab(const QString &path);
+    QVector<qint64> tokenize(const QString &text) const;
+    void wordPiece(const QString &word, QVector<qint64> &ids) const;
+
+    QString modelDir;
+    int threads = 0;
+
+    QMutex loadMtx;
+    bool loaded = false;
+    bool failed = false;
+
+    QHash<QString, qint64> vocab;
+    qint64 clsID = -1;
+    qint64 sepID = -1;
+    qint64 padID = 0;
+    qint64 unkID = -1;
+
+    std::unique_ptr<Ort::Env> env;
+    std::unique_ptr<Ort::Session> session;
+    std::vector<std::string> inputNames;
+    std::string outputName;
+};
+
+#endif // ONNXEMBEDDINGBACKEND_H
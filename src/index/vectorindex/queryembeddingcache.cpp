@@ -0,0 +1,193 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "queryembeddingcache.h"
+#include "vectorindex.h"
+#include "config/configmanager.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <algorithm>
+
+static constexpr int kDefaultQueryCacheSize { 512 };   // 条目数
+static constexpr quint32 kQueryCacheMagic { 0x51454331 };   // "QEC1"
+static constexpr char kQueryCacheFile[] { "query_embedding.cache" };
+
+QueryEmbeddingCache *QueryEmbeddingCache::instance()
+{
+    static QueryEmbeddingCache ins;
+    return &ins;
+}
+
+QueryEmbeddingCache::QueryEmbeddingCache()
+{
+    int size = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_QUERY_CACHE_SIZE,
+                                       kDefaultQueryCacheSize).toInt();
+    cache.setMaxCost(qMax(0, size));
+    persist = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_QUERY_CACHE_PERSIST, true).toBool();
+}
+
+QString QueryEmbeddingCache::normalizeQuery(const QString &query)
+{
+    // 全半角统一、去除首尾空白并合并连续空白
+    return query.normalized(QString::NormalizationForm_KC).simplified();
+}
+
+void QueryEmbeddingCache::setModel(const QString &model)
+{
+    QMutexLocker lk(&mtx);
+    modelName = model;
+}
+
+bool QueryEmbeddingCache::find(const QString &query, QVector<float> &vector)
+{
+    QMutexLocker lk(&mtx);
+    load();
+
+    QVector<float> *cached = cache.object(cacheKey(query));
+    if (!cached) {
+        missCount++;
+        return false;
+    }
+
+    hitCount++;
+    touch(cacheKey(query));
+    vector = *cached;
+    return true;
+}
+
+void QueryEmbeddingCache::insert(const QString &query, const QVector<float> &vector)
+{
+    if (vector.isEmpty())
+        return;
+
+    QMutexLocker lk(&mtx);
+    load();
+    const QString key = cacheKey(query);
+    cache.insert(key, new QVector<float>(vector));
+    touch(key);
+    dirty = true;
+}
+
+void QueryEmbeddingCache::clear()
+{
+    QMutexLocker lk(&mtx);
+    cache.clear();
+    lastUsed.clear();
+    dirty = true;
+}
+
+bool QueryEmbeddingCache::save()
+{
+    QMutexLocker lk(&mtx);
+    if (!persist || !dirty)
+        return true;
+
+    QSaveFile file(cacheFile());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write query embedding cache" << cacheFile();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    // 由久到新写出，载入时依次插入即恢复 LRU 顺序
+    QList<QString> keys = cache.keys();
+    std::sort(keys.begin(), keys.end(), [this](const QString &a, const QString &b) {
+        return lastUsed.value(a) < lastUsed.value(b);
+    });
+    out << kQueryCacheMagic << static_cast<qint32>(keys.size());
+    for (const QString &key : keys)
+        out << key << *cache.object(key);
+
+    if (!file.commit())
+        return false;
+
+    dirty = false;
+    return true;
+}
+
+qint64 QueryEmbeddingCache::hits()
+{
+    QMutexLocker lk(&mtx);
+    return hitCount;
+}
+
+qint64 QueryEmbeddingCache::misses()
+{
+    QMutexLocker lk(&mtx);
+    return missCount;
+}
+
+int QueryEmbeddingCache::size()
+{
+    QMutexLocker lk(&mtx);
+    return cache.size();
+}
+
+QString QueryEmbeddingCache::cacheKey(const QString &query) const
+{
+    return modelName + QChar('\n') + normalizeQuery(query);
+}
+
+QString QueryEmbeddingCache::cacheFile() const
+{
+    return VectorIndex::workerDir() + QDir::separator() + kQueryCacheFile;
+}
+
+void QueryEmbeddingCache::load()
+{
+    if (loaded)
+        return;
+
+    loaded = true;
+    if (!persist)
+        return;
+
+    QFile file(cacheFile());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 magic = 0;
+    qint32 count = 0;
+    in >> magic >> count;
+    if (magic != kQueryCacheMagic) {
+        qWarning() << "invalid query embedding cache" << cacheFile();
+        return;
+    }
+
+    // 其他模型的向量不可复用，载入时丢弃；文件中由久到新排列
+    const QString prefix = modelName + QChar('\n');
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QString key;
+        QVector<float> vector;
+        in >> key >> vector;
+        if (in.status() == QDataStream::Ok && key.startsWith(prefix) && !vector.isEmpty()) {
+            cache.insert(key, new QVector<float>(vector));
+            touch(key);
+        }
+    }
+    qInfo() << "load query embedding cache:" << cache.size();
+}
+
+void QueryEmbeddingCache::touch(const QString &key)
+{
+    lastUsed.insert(key, ++useClock);
+
+    // 被淘汰的键不会主动移除，超出容量较多时清理一次
+    if (lastUsed.size() > 2 * qMax(1, cache.maxCost())) {
+        for (auto it = lastUsed.begin(); it != lastUsed.end();) {
+            if (cache.contains(it.key()))
+                ++it;
+            else
+                it = lastUsed.erase(it);
+        }
+    }
+}
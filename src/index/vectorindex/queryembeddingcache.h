@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef QUERYEMBEDDINGCACHE_H
+#define QUERYEMBEDDINGCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#define QueryEmbeddingCacheIns QueryEmbeddingCache::instance()
+
+// 查询向量 LRU 缓存：以模型名与规范化后的查询文本为键，各应用共享，可持久化
+class QueryEmbeddingCache
+{
+public:
+    static QueryEmbeddingCache *instance();
+    static QString normalizeQuery(const QString &query);
+
+    void setModel(const QString &model);
+
+    bool find(const QString &query, QVector<float> &vector);
+    void insert(const QString &query, const QVector<float> &vector);
+    void clear();
+
+    bool save();
+
+    qint64 hits();
+    qint64 misses();
+    int size();
+
+private:
+    explicit QueryEmbeddingCache();
+    QString cacheKey(const QString &query) const;
+    QString cacheFile() const;
+    void load();
+    void touch(const QString &key);
+
+    QCache<QString, QVector<float>> cache;
+    // QCache 不提供访问顺序，另记每个键最近一次访问的序号，持久化时按此顺序写出
+    QHash<QString, quint64> lastUsed;
+    quint64 useClock = 0;
+    QString modelName;
+    bool persist = true;
+    bool loaded = false;
+    bool dirty = false;
+
+    qint64 hitCount = 0;
+    qint64 missCount = 0;
+
+    QMutex mtx;
+};
+
+#endif // QUERYEMBEDDINGCACHE_H
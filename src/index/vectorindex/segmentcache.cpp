@@ -0,0 +1,192 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "segmentcache.h"
+#include "../global_define.h"
+#include "config/configmanager.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
+
+#include <faiss/IndexFlatCodes.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/index_io.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <iostream>
+
+static constexpr qint64 kDefaultSegmentCacheBudget { 256 };   // 256MB
+
+SegmentCache *SegmentCache::instance()
+{
+    static SegmentCache ins;
+    return &ins;
+}
+
+SegmentCache::SegmentCache()
+{
+    qint64 budgetMB = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_SEGMENT_CACHE_BUDGET,
+                                              kDefaultSegmentCacheBudget).toLongLong();
+    budgetBytes = qMax<qint64>(0, budgetMB) * 1024 * 1024;
+}
+
+QSharedPointer<faiss::Index> SegmentCache::acquire(const QString &indexPath)
+{
+    QFileInfo fileInfo(indexPath);
+    if (!fileInfo.exists())
+        return {};
+
+    const qint64 fileSize = fileInfo.size();
+    const qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+    {
+        QMutexLocker lk(&mtx);
+        auto it = segments.find(indexPath);
+        if (it != segments.end()) {
+            // 段文件被替换后重新加载
+            if (it->fileSize == fileSize && it->lastModified == lastModified) {
+                touch(indexPath);
+                return it->index;
+            }
+            remove(indexPath);
+        }
+    }
+
+    // 读取磁盘不持锁，避免阻塞其他段的命中
+    faiss::Index *index = loadIndex(indexPath);
+    if (!index)
+        return {};
+
+    Segment seg;
+    seg.index = QSharedPointer<faiss::Index>(index);
+    seg.bytes = indexMemoryBytes(index);
+    seg.fileSize = fileSize;
+    seg.lastModified = lastModified;
+
+    QMutexLocker lk(&mtx);
+    auto it = segments.find(indexPath);
+    if (it != segments.end() && it->fileSize == fileSize && it->lastModified == lastModified) {
+        // 其他线程已加载
+        touch(indexPath);
+        return it->index;
+    }
+
+    remove(indexPath);
+    segments.insert(indexPath, seg);
+    lruList.prepend(indexPath);
+    usedBytes += seg.bytes;
+    evict();
+
+    return seg.index;
+}
+
+void SegmentCache::invalidate(const QString &indexPath)
+{
+    QMutexLocker lk(&mtx);
+    remove(indexPath);
+}
+
+void SegmentCache::invalidateDir(const QString &indexDir)
+{
+    const QString dirPath = QDir(indexDir).absolutePath() + QDir::separator();
+
+    QMutexLocker lk(&mtx);
+    for (const QString &path : segments.keys()) {
+        if (path.startsWith(dirPath))
+            remove(path);
+    }
+}
+
+void SegmentCache::setBudget(qint64 bytes)
+{
+    QMutexLocker lk(&mtx);
+    budgetBytes = qMax<qint64>(0, bytes);
+    evict();
+}
+
+qint64 SegmentCache::budget()
+{
+    QMutexLocker lk(&mtx);
+    return budgetBytes;
+}
+
+qint64 SegmentCache::residentBytes()
+{
+    QMutexLocker lk(&mtx);
+    return usedBytes;
+}
+
+qint64 SegmentCache::indexMemoryBytes(const faiss::Index *index)
+{
+    if (!index)
+        return 0;
+
+    if (auto idMap = dynamic_cast<const faiss::IndexIDMap *>(index))
+        return static_cast<qint64>(idMap->id_map.size() * sizeof(faiss::idx_t)) + indexMemoryBytes(idMap->index);
+
+    if (auto refine = dynamic_cast<const faiss::IndexRefine *>(index))
+        return indexMemoryBytes(refine->base_index) + indexMemoryBytes(refine->refine_index);
+
+    if (auto flatCodes = dynamic_cast<const faiss::IndexFlatCodes *>(index))
+        return static_cast<qint64>(flatCodes->codes.size());
+
+    if (auto ivf = dynamic_cast<const faiss::IndexIVF *>(index)) {
+        // mmap 的倒排表由内核按需换入换出，不计入常驻预算
+        qint64 bytes = indexMemoryBytes(ivf->quantizer);
+        if (dynamic_cast<const faiss::ArrayInvertedLists *>(ivf->invlists))
+            bytes += static_cast<qint64>(ivf->ntotal * (ivf->code_size + sizeof(faiss::idx_t)));
+        return bytes;
+    }
+
+    return static_cast<qint64>(index->ntotal * index->d * sizeof(float));
+}
+
+faiss::Index *SegmentCache::loadIndex(const QString &indexPath)
+{
+    // IVF 段的倒排表支持 mmap，Flat 段整体读入
+    int ioFlags = 0;
+    if (QFileInfo(indexPath).fileName().startsWith(QString(kFaissIvfFlatIndex))
+            || QFileInfo(indexPath).fileName().startsWith(QString(kFaissIvfPQIndex)))
+        ioFlags = faiss::IO_FLAG_MMAP | faiss::IO_FLAG_READ_ONLY;
+
+    try {
+        return faiss::read_index(indexPath.toStdString().c_str(), ioFlags);
+    } catch (faiss::FaissException &e) {
+        std::cerr << "Faiss error: " << e.what() << std::endl;
+    }
+
+    return nullptr;
+}
+
+void SegmentCache::touch(const QString &indexPath)
+{
+    int pos = lruList.indexOf(indexPath);
+    if (pos > 0)
+        lruList.move(pos, 0);
+}
+
+void SegmentCache::remove(const QString &indexPath)
+{
+    auto it = segments.find(indexPath);
+    if (it == segments.end())
+        return;
+
+    usedBytes -= it->bytes;
+    segments.erase(it);
+    lruList.removeOne(indexPath);
+}
+
+void SegmentCache::evict()
+{
+    // 至少保留最近使用的一个段，正在检索的段由引用计数保证不被释放
+    while (usedBytes > budgetBytes && lruList.size() > 1) {
+        const QString path = lruList.last();
+        qDebug() << "evict faiss segment" << path;
+        remove(path);
+    }
+}
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef SEGMENTCACHE_H
+#define SEGMENTCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+
+#include <faiss/Index.h>
+
+#define SegmentCacheIns SegmentCache::instance()
+
+// 落盘索引段常驻管理：每个段只读取一次，按内存预算 LRU 淘汰
+class SegmentCache
+{
+public:
+    static SegmentCache *instance();
+
+    QSharedPointer<faiss::Index> acquire(const QString &indexPath);
+    void invalidate(const QString &indexPath);
+    void invalidateDir(const QString &indexDir);
+
+    void setBudget(qint64 bytes);
+    qint64 budget();
+    qint64 residentBytes();
+
+    static qint64 indexMemoryBytes(const faiss::Index *index);
+
+private:
+    struct Segment
+    {
+        QSharedPointer<faiss::Index> index;
+        qint64 bytes = 0;
+        qint64 fileSize = 0;
+        qint64 lastModified = 0;
+    };
+
+    explicit SegmentCache();
+    faiss::Index *loadIndex(const QString &indexPath);
+    void touch(const QString &indexPath);
+    void remove(const QString &indexPath);
+    void evict();
+
+    QHash<QString, Segment> segments;
+    QList<QString> lruList;   // 表头为最近使用
+    qint64 budgetBytes = 0;
+    qint64 usedBytes = 0;
+
+    QMutex mtx;
+};
+
+#endif // SEGMENTCACHE_H
@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "textchunker.h"
+
+static inline bool isChunkSpace(ushort c)
+{
+    // 与原实现的 [\s\u200B] 一致，\s 只匹配 ASCII 空白
+    return c == ' ' || (c >= '\t' && c <= '\r') || c == 0x200B;
+}
+
+TextChunker::TextChunker(int maxSize, int minSize)
+    : maxSize(qMax(1, maxSize))
+    , minSize(minSize)
+    , delimiters(defaultDelimiters())
+{
+    pending.reserve(this->maxSize + 1);
+}
+
+void TextChunker::setOverlap(int chars)
+{
+    overlap = qMax(0, chars);
+}
+
+void TextChunker::setDelimiters(const QString &delimiters)
+{
+    this->delimiters = delimiters;
+}
+
+void TextChunker::setMaxChunks(int count)
+{
+    maxChunks = count;
+}
+
+void TextChunker::append(const QChar *data, int size)
+{
+    for (int i = 0; i < size; i++) {
+        if (finished || isFull())
+            return;
+
+        ushort c = data[i].unicode();
+        if (delimiters.contains(QChar(c))) {
+            endPart();
+            continue;
+        }
+
+        if (isChunkSpace(c)) {
+            if (inSpace)
+                continue;
+            inSpace = true;
+            c = ' ';
+        } else {
+            inSpace = false;
+            if (c == '\'')
+                c = '"';   // SQL语句有单引号会报错
+        }
+
+        pending.append(QChar(c));
+        partSize++;
+
+        // 句子超过 maxSize 时最终一定按 maxSize 切分，提前输出以限制 pending 的长度
+        if (pending.size() > maxSize) {
+            emitChunk(pending.constData(), maxSize);
+            pending.remove(0, maxSize);
+            partSplit = true;
+        }
+    }
+}
+
+void TextChunker::finish()
+{
+    if (finished)
+        return;
+    finished = true;
+
+    // 已超出上限时最后一块不会被返回，无需处理剩余文本
+    if (isFull())
+        return;
+
+    endPart();
+    if (pending.size() > minSize || spans.isEmpty()) {
+        emitChunk(pending.constData(), pending.size());
+    } else {
+        arena.append(pending);
+        spans.last().length += pending.size();
+    }
+    pending.clear();
+}
+
+void TextChunker::reset()
+{
+    arena.clear();
+    spans.clear();
+    pending.clear();
+    partSize = 0;
+    partSplit = false;
+    inSpace = false;
+    finished = false;
+}
+
+bool TextChunker::isFull() const
+{
+    return maxChunks > 0 && spans.size() > maxChunks;
+}
+
+int TextChunker::count() const
+{
+    return maxChunks > 0 ? qMin(spans.size(), maxChunks) : spans.size();
+}
+
+TextChunker::Span TextChunker::span(int index) const
+{
+    return spans.value(index);
+}
+
+QString TextChunker::chunk(int index) const
+{
+    const Span s = span(index);
+    return arena.mid(s.offset, s.length);
+}
+
+QStringList TextChunker::chunks() const
+{
+    QStringList list;
+    const int n = count();
+    list.reserve(n);
+    for (int i = 0; i < n; i++)
+        list << chunk(i);
+    return list;
+}
+
+QString TextChunker::defaultDelimiters()
+{
+    return QString::fromUtf8("，；。,.");
+}
+
+void TextChunker::endPart()
+{
+    inSpace = false;
+    if (partSize == 0)
+        return;
+    partSize = 0;
+
+    const int size = pending.size();
+    if (partSplit) {
+        // 切分后的剩余不足 maxSize 时并入下一句
+        partSplit = false;
+        if (size == maxSize) {
+            emitChunk(pending.constData(), size);
+            pending.clear();
+        }
+        return;
+    }
+
+    if (size > minSize && size < maxSize) {
+        emitChunk(pending.constData(), size);
+        pending.clear();
+    }
+}
+
+void TextChunker::emitChunk(const QChar *data, int size)
+{
+    Span s;
+    s.offset = arena.size();
+    s.length = size;
+    if (overlap > 0 && !spans.isEmpty()) {
+        const int extra = qMin(overlap, s.offset);
+        s.offset -= extra;
+        s.length += extra;
+    }
+
+    arena.append(data, size);
+    spans.append(s);
+}
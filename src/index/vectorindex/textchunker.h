@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef TEXTCHUNKER_H
+#define TEXTCHUNKER_H
+
+#include "../global_define.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// 流式文本分块：逐字符扫描一遍，空白合并与断句同时完成，分块首尾相接写入 arena，以 (offset, length) 引用
+// 默认参数下与原 textsSpliter 的结果一致：按 "，；。,." 断句，超过 maxSize 的句子按 maxSize 切分，
+// 不足 minSize 的句子并入下一句，末尾剩余并入最后一块
+class TextChunker
+{
+public:
+    struct Span
+    {
+        int offset = 0;
+        int length = 0;
+    };
+
+    explicit TextChunker(int maxSize = kMaxChunksSize, int minSize = kMinChunksSize);
+
+    // 每块开头重复上一块末尾的字符数
+    void setOverlap(int chars);
+    void setDelimiters(const QString &delimiters);
+    // 分块数超过 count 后不再接收输入，chunks() 只返回前 count 块；<= 0 不限制
+    void setMaxChunks(int count);
+
+    void append(const QChar *data, int size);
+    inline void append(const QString &text) { append(text.constData(), text.size()); }
+    void finish();
+    // 清空结果，保留已分配的内存以便复用
+    void reset();
+
+    bool isFull() const;
+    int count() const;
+    Span span(int index) const;
+    QString chunk(int index) const;
+    QStringList chunks() const;
+
+    static QString defaultDelimiters();
+
+private:
+    void endPart();
+    void emitChunk(const QChar *data, int size);
+
+    int maxSize = kMaxChunksSize;
+    int minSize = kMinChunksSize;
+    int overlap = 0;
+    int maxChunks = 0;
+    QString delimiters;
+
+    QString arena;
+    QVector<Span> spans;
+
+    QString pending;   // 上一句剩余 + 当前句
+    int partSize = 0;
+    bool partSplit = false;   // 当前句已切出过整块
+    bool inSpace = false;
+    bool finished = false;
+};
+
+#endif // TEXTCHUNKER_H
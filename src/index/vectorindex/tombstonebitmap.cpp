@@ -0,0 +1,141 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "tombstonebitmap.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <algorithm>
+
+static constexpr quint32 kTombstoneMagic { 0x54425331 };   // "TBS1"
+
+TombstoneBitmap::TombstoneBitmap(const QString &sidecarPath)
+    : sidecarPath(sidecarPath)
+{
+}
+
+bool TombstoneBitmap::load()
+{
+    QFile file(sidecarPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint64 count = 0;
+    QByteArray compressed;
+    in >> magic >> count >> compressed;
+    if (in.status() != QDataStream::Ok || magic != kTombstoneMagic) {
+        qWarning() << "invalid tombstone file" << sidecarPath;
+        return false;
+    }
+
+    // 位图大多为连续的 0，落盘时压缩
+    QByteArray raw = qUncompress(compressed);
+    if (raw.isEmpty() && count > 0) {
+        qWarning() << "broken tombstone file" << sidecarPath;
+        return false;
+    }
+
+    QWriteLocker lk(&rwLock);
+    bitmap.resize(raw.size());
+    std::copy(raw.constBegin(), raw.constEnd(), reinterpret_cast<char *>(bitmap.data()));
+    tombstoneCount = count;
+    return true;
+}
+
+bool TombstoneBitmap::save()
+{
+    QByteArray compressed;
+    qint64 count = 0;
+    {
+        QReadLocker lk(&rwLock);
+        compressed = qCompress(reinterpret_cast<const uchar *>(bitmap.constData()), bitmap.size());
+        count = tombstoneCount;
+    }
+
+    QSaveFile file(sidecarPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write tombstone file" << sidecarPath;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << kTombstoneMagic << count << compressed;
+    return file.commit();
+}
+
+void TombstoneBitmap::reset(const QVector<faiss::idx_t> &ids)
+{
+    {
+        QWriteLocker lk(&rwLock);
+        bitmap.clear();
+        tombstoneCount = 0;
+    }
+    set(ids);
+}
+
+void TombstoneBitmap::set(const QVector<faiss::idx_t> &ids)
+{
+    QWriteLocker lk(&rwLock);
+    for (faiss::idx_t id : ids) {
+        if (id < 0)
+            continue;
+
+        int pos = static_cast<int>(id >> 3);
+        if (pos >= bitmap.size())
+            bitmap.resize(pos + 1);
+
+        uint8_t mask = static_cast<uint8_t>(1 << (id & 7));
+        if (!(bitmap[pos] & mask)) {
+            bitmap[pos] |= mask;
+            tombstoneCount++;
+        }
+    }
+}
+
+void TombstoneBitmap::clear(const QVector<faiss::idx_t> &ids)
+{
+    QWriteLocker lk(&rwLock);
+    for (faiss::idx_t id : ids) {
+        int pos = static_cast<int>(id >> 3);
+        if (id < 0 || pos >= bitmap.size())
+            continue;
+
+        uint8_t mask = static_cast<uint8_t>(1 << (id & 7));
+        if (bitmap[pos] & mask) {
+            bitmap[pos] &= static_cast<uint8_t>(~mask);
+            tombstoneCount--;
+        }
+    }
+}
+
+bool TombstoneBitmap::contains(faiss::idx_t id) const
+{
+    int pos = static_cast<int>(id >> 3);
+    return id >= 0 && pos < bitmap.size() && (bitmap[pos] & (1 << (id & 7)));
+}
+
+qint64 TombstoneBitmap::count() const
+{
+    return tombstoneCount;
+}
+
+const uint8_t *TombstoneBitmap::data() const
+{
+    return bitmap.constData();
+}
+
+size_t TombstoneBitmap::size() const
+{
+    return static_cast<size_t>(bitmap.size());
+}
+
+QReadWriteLock *TombstoneBitmap::lock()
+{
+    return &rwLock;
+}
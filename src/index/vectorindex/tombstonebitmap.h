@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef TOMBSTONEBITMAP_H
+#define TOMBSTONEBITMAP_H
+
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+
+#include <faiss/Index.h>
+
+// 落盘向量的删除标记：按 faiss id 置位，常驻内存并以压缩旁路文件持久化
+class TombstoneBitmap
+{
+public:
+    explicit TombstoneBitmap(const QString &sidecarPath);
+
+    bool load();
+    bool save();
+
+    void reset(const QVector<faiss::idx_t> &ids);
+    void set(const QVector<faiss::idx_t> &ids);
+    void clear(const QVector<faiss::idx_t> &ids);
+
+    bool contains(faiss::idx_t id) const;
+    qint64 count() const;
+
+    // 供 faiss::IDSelectorBitmap 直接引用，使用期间需持有读锁
+    const uint8_t *data() const;
+    size_t size() const;
+    QReadWriteLock *lock();
+
+private:
+    QString sidecarPath;
+    QVector<uint8_t> bitmap;
+    qint64 tombstoneCount = 0;
+
+    QReadWriteLock rwLock;
+};
+
+#endif // TOMBSTONEBITMAP_H
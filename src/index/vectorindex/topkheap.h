@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef TOPKHEAP_H
+#define TOPKHEAP_H
+
+#include <QString>
+#include <QVector>
+
+#include <faiss/Index.h>
+
+#include <algorithm>
+#include <vector>
+
+// 检索结果：距离、向量ID、所在索引段（内存缓存索引为空）
+struct SearchResult
+{
+    SearchResult() {}
+    SearchResult(float distance, faiss::idx_t id, const QString &segment)
+        : distance(distance), id(id), segment(segment) {}
+
+    float distance = 0.f;
+    faiss::idx_t id = -1;
+    QString segment;
+};
+
+// 有界 top-K 堆，合并各索引段的检索结果；距离相同的结果全部保留
+// L2 距离越小越相近，内积相似度越大越相近
+class TopKHeap
+{
+public:
+    explicit TopKHeap(int k, bool largerIsBetter = false)
+        : topK(k)
+        , largerIsBetter(largerIsBetter)
+    {
+        heap.reserve(static_cast<size_t>(qMax(0, k)));
+    }
+
+    void push(float distance, faiss::idx_t id, const QString &segment)
+    {
+        if (topK <= 0)
+            return;
+
+        if (static_cast<int>(heap.size()) < topK) {
+            heap.push_back(SearchResult(distance, id, segment));
+            std::push_heap(heap.begin(), heap.end(), compare());
+            return;
+        }
+
+        if (!closer(distance, heap.front().distance))
+            return;
+
+        std::pop_heap(heap.begin(), heap.end(), compare());
+        heap.back() = SearchResult(distance, id, segment);
+        std::push_heap(heap.begin(), heap.end(), compare());
+    }
+
+    // 由近到远排序的结果
+    QVector<SearchResult> results() const
+    {
+        std::vector<SearchResult> sorted = heap;
+        std::sort_heap(sorted.begin(), sorted.end(), compare());
+        return QVector<SearchResult>::fromStdVector(sorted);
+    }
+
+private:
+    bool closer(float lhs, float rhs) const
+    {
+        return largerIsBetter ? lhs > rhs : lhs < rhs;
+    }
+
+    // 堆顶为当前最远的结果
+    struct Compare
+    {
+        bool largerIsBetter;
+        bool operator()(const SearchResult &lhs, const SearchResult &rhs) const
+        {
+            return largerIsBetter ? lhs.distance > rhs.distance : lhs.distance < rhs.distance;
+        }
+    };
+
+    Compare compare() const
+    {
+        return Compare { largerIsBetter };
+    }
+
+    int topK = 0;
+    bool largerIsBetter = false;
+    std::vector<SearchResult> heap;
+};
+
+#endif // TOPKHEAP_H
@@ -3,10 +3,13 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "vectorindex.h"
+#include "segmentcache.h"
 #include "../global_define.h"
 #include "database/embeddatabase.h"
+#include "config/configmanager.h"
 
 #include <QList>
+#include <QSet>
 #include <QFile>
 #include <QDir>
 #include <QDebug>
@@ -18,55 +21,164 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QEventLoop>
+#include <QRegularExpression>
 
 #include <faiss/IndexIVFPQ.h>
+#include <faiss/invlists/InvertedLists.h>
 #include <faiss/index_io.h>
 #include <faiss/index_factory.h>
 #include <faiss/utils/random.h>
 #include <faiss/IndexShards.h>
 #include <faiss/IndexFlatCodes.h>
+#include <faiss/IndexRefine.h>
 #include <faiss/impl/IDSelector.h>
+#include <faiss/utils/distances.h>
+
+#include <omp.h>
+
+static constexpr int kDefaultCompactSegmentCount { 8 };
+static constexpr double kDefaultCompactTombstoneRatio { 0.2 };
+static constexpr qint64 kDefaultCompactSegmentSize { 100000 };   // 向量个数
+static constexpr qint64 kDefaultIvfThreshold { 50000 };   // 向量个数
+static constexpr double kDefaultIvfMinRecall { 0.9 };
+static constexpr int kDefaultNProbe { 16 };
+static constexpr int kIvfRecallTopK { 10 };
+static constexpr int kIvfRecallQueries { 100 };
+static constexpr char kTombstoneFile[] { "tombstone.bitmap" };
+static constexpr char kMetricInnerProduct[] { "IP" };
+static constexpr char kStorageSQ8[] { "SQ8" };
+static constexpr char kStorageSQfp16[] { "SQfp16" };
+static constexpr int kDefaultRefineFactor { 0 };
+static constexpr char kDocumentIndexFile[] { "document.index" };
+static constexpr int kDefaultDocumentTopM { 64 };
+static constexpr int kDefaultDocumentMinCount { 2000 };
+static constexpr int kDefaultDocumentRecallSample { 0 };
+
+static QThreadPool *searchThreadPool()
+{
+    // 段检索线程数取核数的一半，给 DBus 与向量化工作线程留出余量
+    static QThreadPool *pool = []() -> QThreadPool * {
+        QThreadPool *threadPool = new QThreadPool;
+        threadPool->setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+        return threadPool;
+    }();
+    return pool;
+}
+
+static QSharedPointer<faiss::Index> systemAssistantIndex(const QString &indexPath)
+{
+    // 随包安装的知识库索引不会变化，进程内只读取一次且不参与段缓存淘汰
+    static QMutex mtx;
+    static QSharedPointer<faiss::Index> index;
+
+    QMutexLocker lk(&mtx);
+    if (!index) {
+        try {
+            index.reset(faiss::read_index(indexPath.toStdString().c_str(), faiss::IO_FLAG_READ_ONLY));
+        } catch (faiss::FaissException &e) {
+            std::cerr << "Faiss error: " << e.what() << std::endl;
+        }
+    }
+    return index;
+}
+
+static void searchSegment(const faiss::Index *index, int nq, const float *queryVectors, int topK,
+                          float *distances, faiss::idx_t *labels, const faiss::IDSelector *sel, int nprobe)
+{
+    auto idMap = dynamic_cast<const faiss::IndexIDMap *>(index);
+    auto refine = idMap ? dynamic_cast<const faiss::IndexRefine *>(idMap->index) : nullptr;
+    if (!refine) {
+        faiss::SearchParametersIVF param;
+        param.sel = sel;
+        // nprobe 仅对 IVF 冷数据段生效
+        param.nprobe = static_cast<size_t>(qMax(1, nprobe));
+        index->search(nq, queryVectors, topK, distances, labels, &param);
+        return;
+    }
+
+    // 精排段只接受 IndexRefineSearchParameters，id 过滤作用于量化粗排，结果再映射回向量 id
+    faiss::IDSelectorTranslated translated(idMap->id_map, sel);
+    faiss::SearchParameters baseParam;
+    baseParam.sel = &translated;
+    faiss::IndexRefineSearchParameters param;
+    param.k_factor = refine->k_factor;
+    param.base_index_params = &baseParam;
+    refine->search(nq, queryVectors, topK, distances, labels, &param);
+
+    for (faiss::idx_t i = 0; i < static_cast<faiss::idx_t>(nq) * topK; i++) {
+        if (labels[i] >= 0)
+            labels[i] = idMap->id_map[static_cast<size_t>(labels[i])];
+    }
+}
 
 VectorIndex::VectorIndex(QSqlDatabase *db, QMutex *mtx, const QString &appID, QObject *parent)
     :QObject (parent)
     , dataBase(db)
     , dbMtx(mtx)
+    , tombstones(workerDir() + QDir::separator() + appID + QDir::separator() + kTombstoneFile)
+    , documents(workerDir() + QDir::separator() + appID + QDir::separator() + kDocumentIndexFile, metricType(appID))
     , appID(appID)
 {
     dumpIndexIDRange = qMakePair(0, -1);
+    metric = metricType(appID);
+}
+
+faiss::MetricType VectorIndex::metricType(const QString &appID)
+{
+    // 内积度量要求入库与查询向量均已归一化，即余弦相似度
+    QString metricName = ConfigManagerIns->value(VECTOR_INDEX_GROUP, appID + "." + VECTOR_INDEX_METRIC,
+                                                 QString("L2")).toString();
+    return metricName.compare(kMetricInnerProduct, Qt::CaseInsensitive) == 0 ? faiss::METRIC_INNER_PRODUCT
+                                                                             : faiss::METRIC_L2;
 }
 
-bool VectorIndex::updateIndex(int d, const QMap<faiss::idx_t, QVector<float>> &embedVectorCache)
+bool VectorIndex::updateIndex(int d, const QMap<faiss::idx_t, QVector<float>> &embedVectorCache,
+                              const QMap<faiss::idx_t, QPair<QString, QString>> &embedDataCache)
 {
     QMutexLocker lk(&vectorIndexMtx);
     if (embedVectorCache.isEmpty())
         return false;
 
     if (!cacheIndex) {
-        faiss::Index *index = faiss::index_factory(d, kFaissFlatIndex);
+        faiss::Index *index = faiss::index_factory(d, kFaissFlatIndex, metric);
         cacheIndex = new faiss::IndexIDMap(index);
     }
 
-    faiss::idx_t oldNTotal = cacheIndex->ntotal + embedVectorCache.firstKey();
+    // 缓存中的 id 在删除文档后不连续，只追加大于内存索引中最大 id 的向量
+    auto it = cacheIndex->ntotal > 0 ? embedVectorCache.upperBound(cacheIndex->id_map.back())
+                                     : embedVectorCache.cbegin();
     QVector<float> embeddingsTmp;
     QVector<faiss::idx_t> idsTmp;
-
-    for (faiss::idx_t id = oldNTotal; id <= embedVectorCache.lastKey(); id++) {
-        embeddingsTmp += embedVectorCache.value(id);
-        idsTmp << id;
+    for (; it != embedVectorCache.cend(); ++it) {
+        embeddingsTmp += it.value();
+        idsTmp << it.key();
     }
 
-    qInfo() << "***" << idsTmp.size() << idsTmp;
+    if (idsTmp.isEmpty())
+        return true;
+
+    faiss::idx_t oldNTotal = cacheIndex->ntotal;
     cacheIndex->add_with_ids(idsTmp.size(), embeddingsTmp.data(), idsTmp.data());
     faiss::idx_t newNTotal = cacheIndex->ntotal;
 
-    qInfo() << "old total" << oldNTotal;
-    qInfo() << "new total" << newNTotal;
+    qDebug() << appID << "cache index total" << oldNTotal << "->" << newNTotal;
     segmentIds += idsTmp;   //每个segment的索引所对应的IDs
 
     dumpIndexIDRange = qMakePair(cacheIndex->id_map.front(), cacheIndex->id_map.back());
     lk.unlock();
 
+    // 同一文档的文本块 id 连续，按文档更新质心
+    DocumentIndex *docs = documentIndex();
+    for (int begin = 0, end = 0; begin < idsTmp.size(); begin = end) {
+        const QString source = embedDataCache.value(idsTmp[begin]).first;
+        for (end = begin + 1; end < idsTmp.size(); end++) {
+            if (embedDataCache.value(idsTmp[end]).first != source)
+                break;
+        }
+        if (!source.isEmpty())
+            docs->add(source, idsTmp.mid(begin, end - begin), embeddingsTmp.constData() + begin * d, d);
+    }
+
     if (newNTotal >= 100) {
         // UOS-AI添加文档后在内存中，与已经落盘的区分开，手动操作落盘；整理索引碎片等操作。
         Q_EMIT indexDump();
@@ -74,7 +186,7 @@ bool VectorIndex::updateIndex(int d, const QMap<faiss::idx_t, QVector<float>> &e
     return true;
 }
 
-bool VectorIndex::saveIndexToFile(const faiss::Index *index, const QString &indexType)
+bool VectorIndex::saveIndexToFile(const faiss::Index *index, const QVector<faiss::idx_t> &ids, const QString &indexType)
 {
     if (!index || index->ntotal == 0) {
         return false;
@@ -89,13 +201,26 @@ bool VectorIndex::saveIndexToFile(const faiss::Index *index, const QString &inde
             return false;
         }
     }
-    QHash<QString, int> indexFilesNum = getIndexFilesNum();
-    QString indexName = indexType + "_" + QString::number(indexFilesNum.value(indexType)) + ".faiss";
+    QString indexName = indexType + "_" + QString::number(nextIndexFileNum(indexType)) + ".faiss";
     QString indexPath = indexDir.path() + QDir::separator() + indexName;
+    QString tmpPath = indexPath + ".tmp";
     qInfo() << "index file save to " + indexPath;
 
+    // 热数据段按配置的存储格式重新编码
+    QScopedPointer<faiss::Index> storageIndex;
+    auto idMap = dynamic_cast<const faiss::IndexIDMap *>(index);
+    if (indexType == kFaissFlatIndex && idMap) {
+        QVector<float> embeddings(static_cast<int>(idMap->ntotal * idMap->d));
+        idMap->index->reconstruct_n(0, idMap->ntotal, embeddings.data());
+        storageIndex.reset(createSegmentIndex(idMap->d, idMap->ntotal, embeddings.constData(), idMap->id_map.data()));
+    }
+
+    // 段文件先写到临时文件，不占用段锁
+    if (!writeSegmentFile(storageIndex ? storageIndex.data() : index, tmpPath))
+        return false;
+
     QStringList insertStrs;
-    for (faiss::idx_t id : segmentIds) {
+    for (faiss::idx_t id : ids) {
         QString insert = "INSERT INTO " + QString(kEmbeddingDBIndexSegTable)
                 + " (id, " + QString(kEmbeddingDBSegIndexTableBitSet)
                 + ", " + QString(kEmbeddingDBSegIndexIndexName) + ") " + "VALUES ("
@@ -103,21 +228,32 @@ bool VectorIndex::saveIndexToFile(const faiss::Index *index, const QString &inde
         insertStrs << insert;
     }
 
+    // 段文件就位后再写段表，写库失败时删除段文件；检索看不到中间状态
+    QWriteLocker segLk(&segmentLock);
+    if (!QFile::rename(tmpPath, indexPath)) {
+        qWarning() << "Failed to rename segment" << tmpPath;
+        QFile::remove(tmpPath);
+        return false;
+    }
+
+    bool ok = false;
     {
-        //QString query = "SELECT id FROM " + QString(kEmbeddingDBMetaDataTable) + " ORDER BY id DESC LIMIT 1";
         QMutexLocker lk(dbMtx);
-        EmbedDBVendorIns->commitTransaction(dataBase, insertStrs);
+        ok = EmbedDBVendorIns->commitTransaction(dataBase, insertStrs);
     }
 
-    segmentIds.clear();
-
-    try {
-        faiss::write_index(index, indexPath.toStdString().c_str());
-        return true;
-    } catch (faiss::FaissException &e) {
-        std::cerr << "Faiss error: " << e.what() << std::endl;
+    SegmentCacheIns->invalidate(indexPath);
+    if (!ok) {
+        qWarning() << "Failed to insert index segment table, drop segment" << indexPath;
+        QFile::remove(indexPath);
+        return false;
     }
 
+    // 段文件可见的同时停止检索移出的内存索引，同一次检索不会重复命中
+    if (index == dumpingIndex) {
+        QMutexLocker lk(&vectorIndexMtx);
+        dumpingIndex = nullptr;
+    }
     return true;
 }
 
@@ -125,19 +261,27 @@ void VectorIndex::resetCacheIndex(int d, const QMap<faiss::idx_t, QVector<float>
 {
     QVector<float> embeddingsTmp;
     QVector<faiss::idx_t> idsTmp;
-    for (auto id : embedVectorCache.keys()) {
-        embeddingsTmp += embedVectorCache.value(id);
-        idsTmp << id;
-    }
 
     QMutexLocker lk(&vectorIndexMtx);
+    // 落盘失败退回的向量已不在向量化缓存中，位于内存索引前部，重建时保留
+    if (cacheIndex && restoredCount > 0) {
+        embeddingsTmp.resize(restoredCount * cacheIndex->d);
+        cacheIndex->index->reconstruct_n(0, restoredCount, embeddingsTmp.data());
+        for (int i = 0; i < restoredCount; i++)
+            idsTmp << cacheIndex->id_map[static_cast<size_t>(i)];
+    }
+    for (auto it = embedVectorCache.cbegin(); it != embedVectorCache.cend(); ++it) {
+        embeddingsTmp += it.value();
+        idsTmp << it.key();
+    }
+
     if (!cacheIndex) {
-        faiss::Index *index = faiss::index_factory(d, kFaissFlatIndex);
+        faiss::Index *index = faiss::index_factory(d, kFaissFlatIndex, metric);
         cacheIndex = new faiss::IndexIDMap(index);
     }
 
     cacheIndex->reset();
-    cacheIndex->add_with_ids(embedVectorCache.count(), embeddingsTmp.data(), idsTmp.data());
+    cacheIndex->add_with_ids(idsTmp.size(), embeddingsTmp.data(), idsTmp.data());
     int newnTotal = cacheIndex->ntotal;
 
     segmentIds.clear();
@@ -151,99 +295,281 @@ void VectorIndex::resetCacheIndex(int d, const QMap<faiss::idx_t, QVector<float>
     }
 }
 
-void VectorIndex::vectorSearch(int topK, const float *queryVector,
-                               QMap<float, faiss::idx_t> &cacheSearchRes, QMap<float, faiss::idx_t> &dumpSearchRes)
+QVector<SearchResult> VectorIndex::vectorSearch(int topK, const float *queryVector)
+{
+    return vectorSearch(1, topK, queryVector).value(0);
+}
+
+QVector<QVector<SearchResult>> VectorIndex::vectorSearch(int nq, int topK, const float *queryVectors)
+{
+    // 两阶段检索：由文档级索引选出候选文档，落盘段内只计算其文本块；文档数较少时直接全量检索
+    std::vector<faiss::idx_t> candidates;
+    if (nq < 1 || topK < 1 || !selectCandidates(nq, queryVectors, candidates))
+        return searchSegments(nq, topK, queryVectors, nullptr);
+
+    QVector<QVector<SearchResult>> results = searchSegments(nq, topK, queryVectors, &candidates);
+    sampleRecall(nq, topK, queryVectors, results);
+    return results;
+}
+
+QVector<QVector<SearchResult>> VectorIndex::searchSegments(int nq, int topK, const float *queryVectors,
+                                                           const std::vector<faiss::idx_t> *candidates)
 {
-    //QMap<float, faiss::idx_t> searchResult;  <L2距离, ID> Map小到大排序 合并cache和dump两个结果
+    // 每个查询一个 top-K 堆，各索引段的结果汇入后按距离由小到大返回；
+    // 多个查询在每个段上合并为一次 n > 1 的 search，分摊段扫描开销
+    std::vector<TopKHeap> heaps;
+    heaps.reserve(static_cast<size_t>(qMax(0, nq)));
+    for (int q = 0; q < nq; q++)
+        heaps.emplace_back(topK, metric == faiss::METRIC_INNER_PRODUCT);
+
+    auto results = [&heaps]() -> QVector<QVector<SearchResult>> {
+        QVector<QVector<SearchResult>> res;
+        for (const TopKHeap &heap : heaps)
+            res << heap.results();
+        return res;
+    };
+
+    if (nq < 1 || topK < 1)
+        return results();
+
     if (appID == kSystemAssistantKey) {
        //TODO:区分社区版、专业版
         QString indexPath = QString(kSystemAssistantData) + ".faiss";
-        faiss::Index *index;
-        try {
-            index = faiss::read_index(indexPath.toStdString().c_str());
-        } catch (faiss::FaissException &e) {
-            std::cerr << "Faiss error: " << e.what() << std::endl;
-            return;
-        }
+        QSharedPointer<faiss::Index> index = systemAssistantIndex(indexPath);
+        if (!index || !matchMetric(index.data(), indexPath))
+            return results();
 
-        QVector<float> D1(topK);
-        QVector<faiss::idx_t> I1(topK);
-        index->search(1, queryVector, topK, D1.data(), I1.data());
+        QVector<float> D1(nq * topK);
+        QVector<faiss::idx_t> I1(nq * topK, -1);
+        index->search(nq, queryVectors, topK, D1.data(), I1.data());
 
-        for (int id = 0; id < topK; id++) {
-            if (I1[id] == -1 || D1[id] == 0.f)
-                //faiss search -1 表示错误结果
-                break;
-            dumpSearchRes.insert(D1[id], I1[id]);
+        const QString segment = QFileInfo(indexPath).fileName();
+        for (int q = 0; q < nq; q++) {
+            for (int id = q * topK; id < (q + 1) * topK; id++) {
+                if (I1[id] == -1 || D1[id] == 0.f)
+                    //faiss search -1 表示错误结果
+                    break;
+                heaps[static_cast<size_t>(q)].push(D1[id], I1[id], segment);
+            }
         }
-        return;
+        return results();
     }
 
-    //缓存向量检索
-    qInfo() << "load faiss index from cache...";
-    QVector<float> D1Cache(topK);
-    QVector<faiss::idx_t> I1Cache(topK);
+    // 段合并会替换段文件，检索期间持读锁；先段锁后删除标记锁。
+    // 段锁在检索内存索引前获取，落盘时移出的内存索引与新写出的段文件不会在同一次检索中同时出现
+    QReadLocker segLk(&segmentLock);
+
+    //缓存向量检索，包括正在落盘的内存索引
+    qDebug() << "load faiss index from cache...";
+    QVector<float> D1Cache(nq * topK);
+    QVector<faiss::idx_t> I1Cache(nq * topK, -1);
 
     {
         QMutexLocker lk(&vectorIndexMtx);
-        if (cacheIndex) {
-            cacheIndex->search(1, queryVector, topK, D1Cache.data(), I1Cache.data());
-        }
-    }
+        for (faiss::IndexIDMap *index : { cacheIndex, dumpingIndex }) {
+            if (!index)
+                continue;
 
-    for (int i = 0; i < topK; i++) {
-        if (I1Cache[i] == -1 || D1Cache[i] == 0.f)
-            //faiss search -1 表示错误结果
-            break;
-        cacheSearchRes.insert(D1Cache[i], I1Cache[i]);
+            std::fill(I1Cache.begin(), I1Cache.end(), -1);
+            index->search(nq, queryVectors, topK, D1Cache.data(), I1Cache.data());
+            for (int q = 0; q < nq; q++) {
+                for (int i = q * topK; i < (q + 1) * topK; i++) {
+                    if (I1Cache[i] == -1 || D1Cache[i] == 0.f)
+                        //faiss search -1 表示错误结果
+                        break;
+                    heaps[static_cast<size_t>(q)].push(D1Cache[i], I1Cache[i], QString());
+                }
+            }
+        }
     }
-    qInfo() << "cache search result***: " << I1Cache;
 
     //落盘的索引检索
-    qInfo() << "load faiss index from dump...";
+    qDebug() << "load faiss index from dump...";
     QString indexDirStr = workerDir() + QDir::separator() + appID;
     QDir indexDir(indexDirStr);
 
     if (!indexDir.exists()) {
         if (!indexDir.mkpath(indexDirStr)) {
             qWarning() << appID << " directory isn't exists and can't create!";
-            return;
+            return results();
+        }
+    }
+    TombstoneBitmap *deleted = tombstoneBitmap();
+    QReadLocker tombLk(deleted->lock());
+    QStringList indexFiles = getIndexFiles(kFaissFlatIndex).values();
+    indexFiles += getIndexFiles(kFaissIvfFlatIndex).values();
+    indexFiles += getIndexFiles(kFaissIvfPQIndex).values();
+    const int nprobe = ConfigManagerIns->value(VECTOR_INDEX_GROUP, appID + "." + VECTOR_INDEX_NPROBE,
+                                               kDefaultNProbe).toInt();
+
+    // 候选文本块与删除标记合成一个位图，段内每个向量只查一次位
+    QVector<uint8_t> candidateBitmap;
+    if (candidates && !candidates->empty()) {
+        candidateBitmap.resize(static_cast<int>(candidates->back() >> 3) + 1);
+        for (faiss::idx_t id : *candidates) {
+            if (!deleted->contains(id))
+                candidateBitmap[static_cast<int>(id >> 3)] |= static_cast<uint8_t>(1 << (id & 7));
         }
     }
-    QVector<uint8_t> deleteBitset = getDumpDeleteBitSet();
 
-    QHash<QString, int> indexFilesNum = getIndexFilesNum();
-    for (int i = 0; i < indexFilesNum.value(QString(kFaissFlatIndex)); i++) {
-        QString name = QString(kFaissFlatIndex) + "_" + QString::number(i) + ".faiss";
-        QString indexPath = indexDir.path() + QDir::separator() + name;
+    // 各段并发检索，结果在锁内并入堆
+    QMutex heapMtx;
+    QList<QFuture<void>> futures;
+    for (const QString &name : indexFiles) {
+        const QString indexPath = indexDir.path() + QDir::separator() + name;
+        futures << QtConcurrent::run(searchThreadPool(), [&, indexPath, name]() {
+            // 段间已并行，段内固定单线程，避免与 Qt 工作线程争抢 CPU
+            omp_set_num_threads(1);
 
-        faiss::Index *index;
-        try {
-            index = faiss::read_index(indexPath.toStdString().c_str());
-        } catch (faiss::FaissException &e) {
-            std::cerr << "Faiss error: " << e.what() << std::endl;
+            QSharedPointer<faiss::Index> index = SegmentCacheIns->acquire(indexPath);
+            if (!index || !matchMetric(index.data(), name))
+                return;
+
+            // 直接引用常驻的删除标记位图，位图外的 id 视为未删除
+            faiss::IDSelectorBitmap deletedSelect(deleted->size(), deleted->data());
+            faiss::IDSelectorNot notDeletedSelect(&deletedSelect);
+            faiss::IDSelectorBitmap candidateSelect(static_cast<size_t>(candidateBitmap.size()),
+                                                    candidateBitmap.constData());
+            const faiss::IDSelector *idSelect = candidates ? static_cast<const faiss::IDSelector *>(&candidateSelect)
+                                                           : &notDeletedSelect;
+
+            QVector<float> D1(nq * topK);
+            QVector<faiss::idx_t> I1(nq * topK, -1);
+            searchSegment(index.data(), nq, queryVectors, topK, D1.data(), I1.data(), idSelect, nprobe);
+
+            QMutexLocker lk(&heapMtx);
+            for (int q = 0; q < nq; q++) {
+                for (int id = q * topK; id < (q + 1) * topK; id++) {
+                    if (I1[id] == -1 || D1[id] == 0.f)
+                        //faiss search -1 表示错误结果
+                        break;
+                    heaps[static_cast<size_t>(q)].push(D1[id], I1[id], name);
+                }
+            }
+        });
+    }
+
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+
+    return results();
+}
+
+void VectorIndex::markDeleted(const QVector<faiss::idx_t> &ids)
+{
+    if (ids.isEmpty())
+        return;
+
+    TombstoneBitmap *deleted = tombstoneBitmap();
+    deleted->set(ids);
+    deleted->save();
+}
+
+void VectorIndex::removeDocuments(const QStringList &sources)
+{
+    if (sources.isEmpty())
+        return;
+
+    documentIndex()->remove(sources);
+    saveDocumentIndex();
+}
+
+bool VectorIndex::rebuildDocumentIndex()
+{
+    if (appID == kSystemAssistantKey)
+        return false;
+
+    documentIndex();
+    {
+        QMutexLocker lk(&documentsMtx);
+        if (!documentsRebuild)
+            return false;
+    }
+
+    // 内存缓存中的文本块尚未写入元数据表，等全部落盘后再由段重建
+    {
+        QMutexLocker lk(&vectorIndexMtx);
+        if (cacheIndex && cacheIndex->ntotal > 0)
+            return false;
+    }
+
+    QList<QVariantList> result;
+    QString query = "SELECT " + QString(kEmbeddingDBMetaDataTableID) + ", " + QString(kEmbeddingDBMetaDataTableSource)
+            + " FROM " + QString(kEmbeddingDBMetaDataTable);
+    {
+        QMutexLocker lk(dbMtx);
+        EmbedDBVendorIns->executeQuery(dataBase, query, result);
+    }
+
+    QHash<faiss::idx_t, QString> sources;
+    sources.reserve(result.size());
+    for (const QVariantList &res : result) {
+        if (res.size() > 1 && res[0].isValid())
+            sources.insert(res[0].toLongLong(), res[1].toString());
+    }
+
+    QString indexDirStr = workerDir() + QDir::separator() + appID;
+    QStringList indexFiles = getIndexFiles(kFaissFlatIndex).values();
+    indexFiles += getIndexFiles(kFaissIvfFlatIndex).values();
+    indexFiles += getIndexFiles(kFaissIvfPQIndex).values();
+
+    // 各文档的文本块向量之和；冷数据层按倒排表逐条解码，量化段的质心为近似值
+    QHash<QString, QVector<faiss::idx_t>> chunks;
+    QHash<QString, QVector<float>> sums;
+    int d = 0;
+    auto accumulate = [&](faiss::idx_t id, const float *vector) {
+        auto it = sources.constFind(id);
+        if (it == sources.constEnd())
             return;
-        }
 
-        faiss::IDSelectorBitmap *idSelect = new faiss::IDSelectorBitmap(deleteBitset.size(), deleteBitset.data());
-        faiss::SearchParameters *param = new faiss::SearchParameters();
-        param->sel = idSelect;
+        chunks[it.value()] << id;
+        QVector<float> &sum = sums[it.value()];
+        if (sum.isEmpty())
+            sum.fill(0.f, d);
+        for (int j = 0; j < d; j++)
+            sum[j] += vector[j];
+    };
 
-        QVector<float> D1(topK);
-        QVector<faiss::idx_t> I1(topK);
-        index->search(1, queryVector, topK, D1.data(), I1.data(), param);
+    for (const QString &name : indexFiles) {
+        QSharedPointer<faiss::Index> index = SegmentCacheIns->acquire(indexDirStr + QDir::separator() + name);
+        if (!index || !matchMetric(index.data(), name) || (d > 0 && index->d != d))
+            continue;
+        d = index->d;
 
-        for (int id = 0; id < topK; id++) {
-            if (I1[id] == -1 || D1[id] == 0.f)
-                //faiss search -1 表示错误结果
-                break;
-            dumpSearchRes.insert(D1[id], I1[id]);
+        QVector<float> vector(d);
+        try {
+            if (auto idMap = dynamic_cast<faiss::IndexIDMap *>(index.data())) {
+                for (faiss::idx_t i = 0; i < idMap->ntotal; i++) {
+                    idMap->index->reconstruct(i, vector.data());
+                    accumulate(idMap->id_map[static_cast<size_t>(i)], vector.constData());
+                }
+            } else if (auto ivf = dynamic_cast<faiss::IndexIVF *>(index.data())) {
+                for (size_t list = 0; list < ivf->nlist; list++) {
+                    const size_t size = ivf->invlists->list_size(list);
+                    faiss::InvertedLists::ScopedIds ids(ivf->invlists, list);
+                    for (size_t offset = 0; offset < size; offset++) {
+                        ivf->reconstruct_from_offset(static_cast<int64_t>(list), static_cast<int64_t>(offset),
+                                                     vector.data());
+                        accumulate(ids[offset], vector.constData());
+                    }
+                }
+            }
+        } catch (faiss::FaissException &e) {
+            std::cerr << "Faiss error: " << e.what() << std::endl;
+            return false;
         }
-        qInfo() << "dump search result***: " << I1;
     }
 
-    //检索结果处理
-    //TODO:检索结果后处理-去重、过于相近或远
+    documentIndex()->reset(chunks, sums, d > 0 ? d : EmbeddingDim);
+    if (!saveDocumentIndex())
+        return false;
+
+    {
+        QMutexLocker lk(&documentsMtx);
+        documentsRebuild = false;
+    }
+    qInfo() << appID << "rebuild document index from segments, documents:" << chunks.size();
+    return true;
 }
 
 QPair<faiss::idx_t, faiss::idx_t> VectorIndex::getDumpIndexIDRange()
@@ -253,20 +579,548 @@ QPair<faiss::idx_t, faiss::idx_t> VectorIndex::getDumpIndexIDRange()
 }
 
 void VectorIndex::doIndexDump()
+{
+    // 内存索引移出后在锁外重新编码、写库与写文件，期间检索与入库都不必等待
+    faiss::IndexIDMap *index = nullptr;
+    QVector<faiss::idx_t> ids;
+    {
+        QMutexLocker lk(&vectorIndexMtx);
+        if (!cacheIndex)
+            return;
+
+        index = cacheIndex;
+        dumpingIndex = cacheIndex;
+        cacheIndex = nullptr;
+        ids.swap(segmentIds);
+        restoredCount = 0;
+        dumpIndexIDRange = qMakePair(0, -1);
+    }
+
+    if (!saveIndexToFile(index, ids, kFaissFlatIndex)) {
+        // 落盘失败时退回内存索引，向量不丢失，下次落盘时重试
+        qWarning() << appID << "dump index failed, keep" << ids.size() << "vectors in memory";
+        restoreCacheIndex(index, ids);
+        return;
+    }
+
+    {
+        QMutexLocker lk(&vectorIndexMtx);
+        dumpingIndex = nullptr;
+    }
+    delete index;
+
+    // 质心与落盘段同步持久化
+    saveDocumentIndex();
+}
+
+void VectorIndex::restoreCacheIndex(faiss::IndexIDMap *index, const QVector<faiss::idx_t> &ids)
 {
     QMutexLocker lk(&vectorIndexMtx);
+    // 落盘期间新加入的向量 id 更大，追加在退回的向量之后，保持 id_map 末尾为最大 id
+    if (cacheIndex) {
+        QVector<float> embeddings(static_cast<int>(cacheIndex->ntotal * cacheIndex->d));
+        cacheIndex->index->reconstruct_n(0, cacheIndex->ntotal, embeddings.data());
+        index->add_with_ids(cacheIndex->ntotal, embeddings.constData(), cacheIndex->id_map.data());
+        delete cacheIndex;
+    }
+
+    cacheIndex = index;
+    dumpingIndex = nullptr;
+    segmentIds = ids + segmentIds;
+    restoredCount = ids.size();
+    dumpIndexIDRange = qMakePair(cacheIndex->id_map.front(), cacheIndex->id_map.back());
+}
+
+bool VectorIndex::needCompact()
+{
+    if (appID == kSystemAssistantKey)
+        return false;
+
+    const int segmentCount = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_COMPACT_SEGMENT_COUNT,
+                                                     kDefaultCompactSegmentCount).toInt();
+    const double tombstoneRatio = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_COMPACT_TOMBSTONE_RATIO,
+                                                          kDefaultCompactTombstoneRatio).toDouble();
+
+    const qint64 segmentSize = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_COMPACT_SEGMENT_SIZE,
+                                                       kDefaultCompactSegmentSize).toLongLong();
+
+    // 与 doIndexCompact 的选段条件一致，只统计可合并的小段；已达上限的大段不再触发合并
+    QString indexDirStr = workerDir() + QDir::separator() + appID;
+    int smallSegments = 0;
+    for (const QString &name : getIndexFiles(kFaissFlatIndex)) {
+        QSharedPointer<faiss::Index> index = SegmentCacheIns->acquire(indexDirStr + QDir::separator() + name);
+        auto idMap = dynamic_cast<faiss::IndexIDMap *>(index.data());
+        if (idMap && matchMetric(idMap, name) && idMap->ntotal < segmentSize)
+            smallSegments++;
+    }
+    if (smallSegments >= segmentCount)
+        return true;
+
+    QList<QVariantList> result;
+    QString query = "SELECT COUNT(*), SUM(" + QString(kEmbeddingDBSegIndexTableBitSet) + ") FROM "
+            + QString(kEmbeddingDBIndexSegTable);
+    {
+        QMutexLocker lk(dbMtx);
+        EmbedDBVendorIns->executeQuery(dataBase, query, result);
+    }
+
+    if (result.isEmpty() || !result[0][0].isValid() || !result[0][1].isValid())
+        return false;
+
+    qint64 total = result[0][0].toLongLong();
+    qint64 deleted = result[0][1].toLongLong();
+    return total > 0 && deleted > 0 && static_cast<double>(deleted) / total >= tombstoneRatio;
+}
+
+bool VectorIndex::doIndexCompact()
+{
+    QString indexDirStr = workerDir() + QDir::separator() + appID;
+    const qint64 segmentSize = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_COMPACT_SEGMENT_SIZE,
+                                                       kDefaultCompactSegmentSize).toLongLong();
+    const QSet<faiss::idx_t> deletedIDs = getDumpDeletedIDs();
+
+    // 选出小段与含删除标记的段
+    QStringList mergeNames;
+    QList<QSharedPointer<faiss::Index>> mergeIndexes;
+    bool hasTombstone = false;
+    const QMap<int, QString> indexFiles = getIndexFiles(kFaissFlatIndex);
+    for (const QString &name : indexFiles) {
+        QSharedPointer<faiss::Index> index = SegmentCacheIns->acquire(indexDirStr + QDir::separator() + name);
+        auto idMap = dynamic_cast<faiss::IndexIDMap *>(index.data());
+        if (!idMap || !matchMetric(idMap, name))
+            continue;
+
+        bool segTombstone = std::any_of(idMap->id_map.begin(), idMap->id_map.end(), [&deletedIDs](faiss::idx_t id) {
+            return deletedIDs.contains(id);
+        });
+        if (idMap->ntotal >= segmentSize && !segTombstone)
+            continue;
+
+        hasTombstone |= segTombstone;
+        mergeNames << name;
+        mergeIndexes << index;
+    }
+
+    if (mergeNames.isEmpty() || (mergeNames.size() < 2 && !hasTombstone))
+        return false;
+
+    qInfo() << appID << "compact faiss segments" << mergeNames;
+
+    // 合并存活向量，丢弃已删除的向量
+    QVector<float> embeddings;
+    QVector<faiss::idx_t> ids;
+    collectSegmentVectors(mergeIndexes, deletedIDs, embeddings, ids);
+
+    QString newName = QString(kFaissFlatIndex) + "_" + QString::number(nextIndexFileNum(kFaissFlatIndex)) + ".faiss";
+    QString tmpPath = indexDirStr + QDir::separator() + newName + ".tmp";
+    if (!ids.isEmpty()) {
+        QScopedPointer<faiss::Index> merged(createSegmentIndex(mergeIndexes.first()->d, ids.size(),
+                                                               embeddings.constData(), ids.constData()));
+        if (!merged || !writeSegmentFile(merged.data(), tmpPath))
+            return false;
+    }
+
+    if (!replaceSegments(mergeNames, ids.isEmpty() ? QString() : newName))
+        return false;
+
+    qInfo() << appID << "compact" << mergeNames.size() << "segments into" << newName
+            << "live vectors:" << ids.size();
+    return true;
+}
 
-    if (!cacheIndex)
+bool VectorIndex::doIvfTier()
+{
+    if (appID == kSystemAssistantKey)
+        return false;
+
+    QString indexDirStr = workerDir() + QDir::separator() + appID;
+    const qint64 threshold = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_IVF_THRESHOLD,
+                                                     kDefaultIvfThreshold).toLongLong();
+    QString ivfType = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_IVF_TYPE,
+                                              QString(kFaissIvfFlatIndex)).toString();
+    if (ivfType != kFaissIvfFlatIndex && ivfType != kFaissIvfPQIndex)
+        ivfType = kFaissIvfFlatIndex;
+
+    // 已有的 IVF 段：冷数据层只保留一个
+    QString ivfName;
+    for (const QString &type : {QString(kFaissIvfFlatIndex), QString(kFaissIvfPQIndex)}) {
+        QMap<int, QString> ivfFiles = getIndexFiles(type);
+        if (!ivfFiles.isEmpty()) {
+            ivfName = ivfFiles.last();
+            ivfType = type;
+            break;
+        }
+    }
+
+    QStringList flatNames;
+    QList<QSharedPointer<faiss::Index>> flatIndexes;
+    faiss::idx_t flatTotal = 0;
+    const QMap<int, QString> flatFiles = getIndexFiles(kFaissFlatIndex);
+    for (const QString &name : flatFiles) {
+        QSharedPointer<faiss::Index> index = SegmentCacheIns->acquire(indexDirStr + QDir::separator() + name);
+        if (!dynamic_cast<faiss::IndexIDMap *>(index.data()) || !matchMetric(index.data(), name))
+            continue;
+
+        flatNames << name;
+        flatIndexes << index;
+        flatTotal += index->ntotal;
+    }
+
+    // 首次建立冷数据层需达到阈值；已有冷数据层时，热数据积累到阈值的 1/10 或冷数据层有删除标记时再并入
+    if (!ivfName.isEmpty()) {
+        QSharedPointer<faiss::Index> ivf = SegmentCacheIns->acquire(indexDirStr + QDir::separator() + ivfName);
+        if (!ivf || !matchMetric(ivf.data(), ivfName))
+            return false;
+    }
+
+    const qint64 promoteSize = ivfName.isEmpty() ? threshold : qMax<qint64>(1, threshold / 10);
+    if (flatTotal < promoteSize && (ivfName.isEmpty() || !segmentHasTombstone(ivfName)))
+        return false;
+
+    const QSet<faiss::idx_t> deletedIDs = getDumpDeletedIDs();
+    QVector<float> embeddings;
+    QVector<faiss::idx_t> ids;
+    collectSegmentVectors(flatIndexes, deletedIDs, embeddings, ids);
+    if (ids.isEmpty() && ivfName.isEmpty())
+        return false;
+
+    const int nprobe = ConfigManagerIns->value(VECTOR_INDEX_GROUP, appID + "." + VECTOR_INDEX_NPROBE,
+                                               kDefaultNProbe).toInt();
+
+    QScopedPointer<faiss::Index> ivfIndex;
+    if (ivfName.isEmpty()) {
+        // 聚类中心个数取 4*sqrt(n)，且保证每个中心至少 39 个训练样本
+        const int d = flatIndexes.first()->d;
+        faiss::idx_t n = ids.size();
+        int nlist = static_cast<int>(4 * std::sqrt(static_cast<double>(n)));
+        nlist = qBound(1, qMin(nlist, static_cast<int>(n / 39)), 65536);
+
+        // PQ 子空间个数须整除维度，取不超过 d/16 的最大约数；维度过小时改用 IVF-Flat
+        int pqM = 0;
+        for (int m = d / 16; m > 0 && ivfType == kFaissIvfPQIndex; m--) {
+            if (d % m == 0) {
+                pqM = m;
+                break;
+            }
+        }
+        if (ivfType == kFaissIvfPQIndex && pqM == 0) {
+            qWarning() << appID << "dimension" << d << "is too small for" << kFaissIvfPQIndex << ", use" << kFaissIvfFlatIndex;
+            ivfType = kFaissIvfFlatIndex;
+        }
+
+        QString factory = ivfType == kFaissIvfPQIndex ? QString("IVF%0,PQ%1").arg(nlist).arg(pqM)
+                                                      : QString("IVF%0,Flat").arg(nlist);
+        qInfo() << appID << "train faiss cold tier" << factory << "vectors:" << n;
+        try {
+            ivfIndex.reset(faiss::index_factory(d, factory.toStdString().c_str(), metric));
+            ivfIndex->train(n, embeddings.data());
+            ivfIndex->add_with_ids(n, embeddings.data(), ids.data());
+        } catch (faiss::FaissException &e) {
+            std::cerr << "Faiss error: " << e.what() << std::endl;
+            return false;
+        }
+
+        double recall = ivfRecall(ivfIndex.data(), embeddings, ids, nprobe);
+        const double minRecall = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_IVF_MIN_RECALL,
+                                                         kDefaultIvfMinRecall).toDouble();
+        qInfo() << appID << "cold tier recall@" << kIvfRecallTopK << "with nprobe" << nprobe << ":" << recall;
+        if (recall < minRecall) {
+            qWarning() << appID << "cold tier recall" << recall << "is lower than" << minRecall << ", keep Flat segments";
+            return false;
+        }
+    } else {
+        // 读入可写副本追加热数据，并清理已删除的向量
+        try {
+            ivfIndex.reset(faiss::read_index((indexDirStr + QDir::separator() + ivfName).toStdString().c_str()));
+            if (!deletedIDs.isEmpty()) {
+                std::vector<faiss::idx_t> removeIDs(deletedIDs.begin(), deletedIDs.end());
+                faiss::IDSelectorBatch removeSel(removeIDs.size(), removeIDs.data());
+                ivfIndex->remove_ids(removeSel);
+            }
+            if (!ids.isEmpty())
+                ivfIndex->add_with_ids(ids.size(), embeddings.data(), ids.data());
+        } catch (faiss::FaissException &e) {
+            std::cerr << "Faiss error: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    QString newName = ivfType + "_" + QString::number(nextIndexFileNum(ivfType)) + ".faiss";
+    QString tmpPath = indexDirStr + QDir::separator() + newName + ".tmp";
+    if (!writeSegmentFile(ivfIndex.data(), tmpPath))
+        return false;
+
+    QStringList oldNames = flatNames;
+    if (!ivfName.isEmpty())
+        oldNames << ivfName;
+
+    if (!replaceSegments(oldNames, newName))
+        return false;
+
+    qInfo() << appID << "move" << ids.size() << "vectors into cold tier" << newName;
+    return true;
+}
+
+bool VectorIndex::segmentHasTombstone(const QString &name)
+{
+    QList<QVariantList> result;
+    QString query = "SELECT COUNT(*) FROM " + QString(kEmbeddingDBIndexSegTable)
+            + " WHERE " + QString(kEmbeddingDBSegIndexIndexName) + " = '" + name + "' AND "
+            + QString(kEmbeddingDBSegIndexTableBitSet) + " = 1";
+    {
+        QMutexLocker lk(dbMtx);
+        EmbedDBVendorIns->executeQuery(dataBase, query, result);
+    }
+
+    if (result.isEmpty() || !result[0][0].isValid())
+        return false;
+    return result[0][0].toLongLong() > 0;
+}
+
+QSet<faiss::idx_t> VectorIndex::getDumpDeletedIDs()
+{
+    QSet<faiss::idx_t> deletedIDs;
+
+    QList<QVariantList> result;
+    QString query = "SELECT id FROM " + QString(kEmbeddingDBIndexSegTable)
+            + " WHERE " + QString(kEmbeddingDBSegIndexTableBitSet) + " = 1";
+    {
+        QMutexLocker lk(dbMtx);
+        EmbedDBVendorIns->executeQuery(dataBase, query, result);
+    }
+    for (const QVariantList &res : result) {
+        if (!res.isEmpty() && res[0].isValid())
+            deletedIDs.insert(res[0].toLongLong());
+    }
+
+    return deletedIDs;
+}
+
+void VectorIndex::collectSegmentVectors(const QList<QSharedPointer<faiss::Index>> &indexes, const QSet<faiss::idx_t> &deletedIDs,
+                                        QVector<float> &embeddings, QVector<faiss::idx_t> &ids)
+{
+    if (indexes.isEmpty())
         return;
 
-    saveIndexToFile(cacheIndex, kFaissFlatIndex);
-    cacheIndex->reset();
-    dumpIndexIDRange = qMakePair(0, -1);
+    const int d = indexes.first()->d;
+    faiss::idx_t total = 0;
+    for (const QSharedPointer<faiss::Index> &index : indexes)
+        total += index->ntotal;
+    embeddings.reserve(static_cast<int>(total * d));
+    ids.reserve(static_cast<int>(total));
+
+    QVector<float> vector(d);
+    for (const QSharedPointer<faiss::Index> &index : indexes) {
+        auto idMap = dynamic_cast<faiss::IndexIDMap *>(index.data());
+        if (!idMap)
+            continue;
+
+        for (faiss::idx_t i = 0; i < idMap->ntotal; i++) {
+            faiss::idx_t id = idMap->id_map[static_cast<size_t>(i)];
+            if (deletedIDs.contains(id))
+                continue;
+
+            idMap->index->reconstruct(i, vector.data());
+            embeddings += vector;
+            ids << id;
+        }
+    }
+}
+
+faiss::Index *VectorIndex::createSegmentIndex(int d, faiss::idx_t n, const float *embeddings, const faiss::idx_t *ids)
+{
+    // 热数据段可选标量量化存储：SQ8 约为 Flat 的 1/4，SQfp16 约为 1/2；
+    // 开启精排时段内同时保存原始向量，以内存换取量化带来的召回损失
+    QString storage = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_STORAGE,
+                                              QString(kFaissFlatIndex)).toString();
+    if (storage != kStorageSQ8 && storage != kStorageSQfp16)
+        storage = kFaissFlatIndex;
+    const int refineFactor = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_REFINE_FACTOR,
+                                                     kDefaultRefineFactor).toInt();
+
+    QString factory = storage;
+    if (storage != kFaissFlatIndex && refineFactor > 1)
+        factory += ",RFlat";
+
+    try {
+        QScopedPointer<faiss::Index> index(faiss::index_factory(d, factory.toStdString().c_str(), metric));
+        if (auto refine = dynamic_cast<faiss::IndexRefine *>(index.data()))
+            refine->k_factor = refineFactor;
+        if (!index->is_trained)
+            index->train(n, embeddings);
+
+        QScopedPointer<faiss::IndexIDMap> idMap(new faiss::IndexIDMap(index.take()));
+        idMap->own_fields = true;
+        idMap->add_with_ids(n, embeddings, ids);
+        return idMap.take();
+    } catch (faiss::FaissException &e) {
+        std::cerr << "Faiss error: " << e.what() << std::endl;
+    }
+
+    return nullptr;
+}
+
+bool VectorIndex::matchMetric(const faiss::Index *index, const QString &name)
+{
+    // 不同度量的距离不可比较，度量配置变更前落盘的段不参与检索与合并
+    if (index->metric_type == metric)
+        return true;
+
+    // 每次检索、合并都会遇到，同一个段只告警一次
+    bool first = false;
+    {
+        QMutexLocker lk(&metricSkippedMtx);
+        if (!metricSkipped.contains(name)) {
+            metricSkipped.insert(name);
+            first = true;
+        }
+    }
+
+    if (first)
+        qWarning() << appID << "segment" << name << "metric" << index->metric_type
+                   << "mismatch with" << metric << ", skipped";
+    else
+        qDebug() << appID << "segment" << name << "metric mismatch, skipped";
+    return false;
+}
+
+bool VectorIndex::writeSegmentFile(const faiss::Index *index, const QString &path)
+{
+    try {
+        faiss::write_index(index, path.toStdString().c_str());
+    } catch (faiss::FaissException &e) {
+        std::cerr << "Faiss error: " << e.what() << std::endl;
+        QFile::remove(path);
+        return false;
+    }
+    return true;
+}
+
+bool VectorIndex::replaceSegments(const QStringList &oldNames, const QString &newName)
+{
+    QString indexDirStr = workerDir() + QDir::separator() + appID;
+
+    QString namesStr = "(";
+    for (const QString &name : oldNames)
+        namesStr += "'" + name + "', ";
+    namesStr.chop(2);
+    namesStr += ")";
+
+    QStringList updateStrs;
+    updateStrs << "DELETE FROM " + QString(kEmbeddingDBIndexSegTable) + " WHERE "
+                  + QString(kEmbeddingDBSegIndexIndexName) + " IN " + namesStr
+                  + " AND " + QString(kEmbeddingDBSegIndexTableBitSet) + " = 1";
+    if (!newName.isEmpty())
+        updateStrs << "UPDATE " + QString(kEmbeddingDBIndexSegTable) + " SET "
+                      + QString(kEmbeddingDBSegIndexIndexName) + " = '" + newName + "' WHERE "
+                      + QString(kEmbeddingDBSegIndexIndexName) + " IN " + namesStr;
+
+    // 被清理的已删除向量不再存在于任何段中，其 id 可能被复用，需同步清除删除标记
+    QList<QVariantList> result;
+    QString queryPurged = "SELECT id FROM " + QString(kEmbeddingDBIndexSegTable) + " WHERE "
+            + QString(kEmbeddingDBSegIndexIndexName) + " IN " + namesStr
+            + " AND " + QString(kEmbeddingDBSegIndexTableBitSet) + " = 1";
+    {
+        QMutexLocker dbLk(dbMtx);
+        EmbedDBVendorIns->executeQuery(dataBase, queryPurged, result);
+    }
+    QVector<faiss::idx_t> purgedIDs;
+    for (const QVariantList &res : result) {
+        if (!res.isEmpty() && res[0].isValid())
+            purgedIDs << res[0].toLongLong();
+    }
+
+    // 替换段文件与改写段表在写锁内完成，检索看不到中间状态
+    QWriteLocker lk(&segmentLock);
+    QString newPath = indexDirStr + QDir::separator() + newName;
+    QString tmpPath = newPath + ".tmp";
+    if (!newName.isEmpty() && !QFile::rename(tmpPath, newPath)) {
+        qWarning() << "Failed to rename segment" << tmpPath;
+        QFile::remove(tmpPath);
+        return false;
+    }
+
+    bool ok = false;
+    {
+        QMutexLocker dbLk(dbMtx);
+        ok = EmbedDBVendorIns->commitTransaction(dataBase, updateStrs);
+    }
+
+    if (!ok) {
+        qWarning() << "Failed to update index segment table, drop segment" << newPath;
+        if (!newName.isEmpty())
+            QFile::remove(newPath);
+        return false;
+    }
+
+    for (const QString &name : oldNames) {
+        QString path = indexDirStr + QDir::separator() + name;
+        QFile::remove(path);
+        SegmentCacheIns->invalidate(path);
+    }
+
+    if (!purgedIDs.isEmpty()) {
+        TombstoneBitmap *deleted = tombstoneBitmap();
+        deleted->clear(purgedIDs);
+        deleted->save();
+    }
+
+    return true;
+}
+
+double VectorIndex::ivfRecall(const faiss::Index *ivfIndex, const QVector<float> &embeddings,
+                              const QVector<faiss::idx_t> &ids, int nprobe)
+{
+    // 从入库向量中等间隔抽取查询，与精确检索结果对比 recall@k
+    const int d = ivfIndex->d;
+    const faiss::idx_t n = ids.size();
+    const int k = static_cast<int>(qMin<faiss::idx_t>(kIvfRecallTopK, n));
+    const int nq = static_cast<int>(qMin<faiss::idx_t>(kIvfRecallQueries, n));
+    if (k < 1 || nq < 1)
+        return 0;
+
+    QVector<float> queries(nq * d);
+    const faiss::idx_t step = n / nq;
+    for (int q = 0; q < nq; q++)
+        std::copy_n(embeddings.constData() + q * step * d, d, queries.data() + q * d);
+
+    QVector<float> exactD(nq * k);
+    QVector<int64_t> exactI(nq * k);
+    if (ivfIndex->metric_type == faiss::METRIC_INNER_PRODUCT)
+        faiss::knn_inner_product(queries.constData(), embeddings.constData(), static_cast<size_t>(d),
+                                 static_cast<size_t>(nq), static_cast<size_t>(n), static_cast<size_t>(k),
+                                 exactD.data(), exactI.data());
+    else
+        faiss::knn_L2sqr(queries.constData(), embeddings.constData(), static_cast<size_t>(d),
+                         static_cast<size_t>(nq), static_cast<size_t>(n), static_cast<size_t>(k),
+                         exactD.data(), exactI.data());
+
+    QVector<float> ivfD(nq * k);
+    QVector<faiss::idx_t> ivfI(nq * k);
+    faiss::SearchParametersIVF param;
+    param.nprobe = static_cast<size_t>(qMax(1, nprobe));
+    ivfIndex->search(nq, queries.constData(), k, ivfD.data(), ivfI.data(), &param);
+
+    int hits = 0;
+    for (int q = 0; q < nq; q++) {
+        QSet<faiss::idx_t> exact;
+        for (int j = 0; j < k; j++) {
+            int64_t pos = exactI[q * k + j];
+            if (pos >= 0)
+                exact.insert(ids[static_cast<int>(pos)]);
+        }
+        for (int j = 0; j < k; j++) {
+            if (exact.contains(ivfI[q * k + j]))
+                hits++;
+        }
+    }
+
+    return static_cast<double>(hits) / (nq * k);
 }
 
-QHash<QString, int> VectorIndex::getIndexFilesNum()
+QMap<int, QString> VectorIndex::getIndexFiles(const QString &indexType)
 {
-    QHash<QString, int> result;
+    QMap<int, QString> result;
 
     QString indexDirStr = workerDir() + QDir::separator() + appID;
     QDir indexDir(indexDirStr);
@@ -277,41 +1131,165 @@ QHash<QString, int> VectorIndex::getIndexFilesNum()
         }
     }
 
+    // 段文件名：<索引类型>_<序号>.faiss，序号在段合并后不再连续
+    QRegularExpression regex("^" + QRegularExpression::escape(indexType) + "_(\\d+)\\.faiss$");
     QFileInfoList fileList = indexDir.entryInfoList(QDir::Files);
+    for (const QFileInfo& fileInfo : fileList) {
+        QRegularExpressionMatch match = regex.match(fileInfo.fileName());
+        if (match.hasMatch())
+            result.insert(match.captured(1).toInt(), fileInfo.fileName());
+    }
+    return result;
+}
+
+int VectorIndex::nextIndexFileNum(const QString &indexType)
+{
+    QMap<int, QString> indexFiles = getIndexFiles(indexType);
+    return indexFiles.isEmpty() ? 0 : indexFiles.lastKey() + 1;
+}
 
-    for (QString indexTypeKey : {kFaissFlatIndex, kFaissIvfFlatIndex, kFaissIvfPQIndex}) {
-        int count = 0;
-        for (const QFileInfo& fileInfo : fileList) {
-            QString fileName = fileInfo.fileName();
-            if (fileName.contains(indexTypeKey))
-                count += 1;
-            result.insert(indexTypeKey, count);
+DocumentIndex *VectorIndex::documentIndex()
+{
+    QMutexLocker lk(&documentsMtx);
+    if (documentsLoaded)
+        return &documents;
+
+    // 旁路文件缺失、损坏或落后于元数据表时，两阶段检索暂停，待工作线程由落盘段重建；
+    // 写库后、保存旁路文件前中断会使旁路文件落后，内存中未落盘的文档也会随中断丢失
+    if (appID != kSystemAssistantKey) {
+        qint64 count = -1;
+        qint64 lastID = -1;
+        qint64 dbCount = -1;
+        qint64 dbLastID = -1;
+        if (!documents.load(count, lastID)) {
+            documentsRebuild = true;
+        } else if (!metaDataStamp(dbCount, dbLastID) || count != dbCount || lastID != dbLastID
+                   || documents.lastChunkID() > dbLastID) {
+            qWarning() << appID << "document index is out of date with metadata table, rebuild";
+            documentsRebuild = true;
         }
     }
-    return result;
+    documentsLoaded = true;
+    return &documents;
+}
+
+bool VectorIndex::saveDocumentIndex()
+{
+    qint64 count = -1;
+    qint64 lastID = -1;
+    if (!metaDataStamp(count, lastID))
+        return false;
+    return documentIndex()->save(count, lastID);
 }
 
-QVector<uint8_t> VectorIndex::getDumpDeleteBitSet()
+bool VectorIndex::metaDataStamp(qint64 &count, qint64 &lastID)
 {
     QList<QVariantList> result;
-    QString query = "SELECT * FROM " + QString(kEmbeddingDBIndexSegTable);
+    QString query = "SELECT COUNT(*), MAX(" + QString(kEmbeddingDBMetaDataTableID) + ") FROM "
+            + QString(kEmbeddingDBMetaDataTable);
     {
         QMutexLocker lk(dbMtx);
-        EmbedDBVendorIns->executeQuery(dataBase, query, result);
+        if (!EmbedDBVendorIns->executeQuery(dataBase, query, result))
+            return false;
     }
 
-    int bitmapSize = static_cast<int>(std::ceil((result.size() >> 3)));
-    if (bitmapSize == 0)
-        bitmapSize += 1;
-    QVector<uint8_t> bitmap(bitmapSize);
-    for (int i = 0; i < bitmapSize; i++) {
-        for (int j = 0; j < 8; j++) {
-            if ((i * 8 + j) >= result.size())
-                break;
-            if (result[i * 8 + j][1].isValid())
-                bitmap[i] |= (!result[i * 8 + j][1].toBool() << j);
+    if (result.isEmpty() || result[0].size() < 2)
+        return false;
+    count = result[0][0].toLongLong();
+    // 空表时 MAX 为 NULL
+    lastID = result[0][1].isNull() ? -1 : result[0][1].toLongLong();
+    return true;
+}
+
+bool VectorIndex::selectCandidates(int nq, const float *queryVectors, std::vector<faiss::idx_t> &candidates)
+{
+    if (appID == kSystemAssistantKey)
+        return false;
+
+    const int topM = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_DOCUMENT_TOP_M,
+                                             kDefaultDocumentTopM).toInt();
+    const int minCount = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_DOCUMENT_MIN_COUNT,
+                                                 kDefaultDocumentMinCount).toInt();
+    if (topM <= 0)
+        return false;
+
+    DocumentIndex *docs = documentIndex();
+    {
+        QMutexLocker lk(&documentsMtx);
+        if (documentsRebuild)
+            return false;
+    }
+    if (docs->count() <= qMax(minCount, topM))
+        return false;
+
+    candidates = docs->select(nq, queryVectors, topM);
+    return !candidates.empty();
+}
+
+void VectorIndex::sampleRecall(int nq, int topK, const float *queryVectors, const QVector<QVector<SearchResult>> &results)
+{
+    // 每 N 次两阶段检索与全量检索对比一次 recall@k，用于评估 DocumentTopM 的取值
+    const int sample = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_DOCUMENT_RECALL_SAMPLE,
+                                               kDefaultDocumentRecallSample).toInt();
+    const qint64 searches = ++twoStageSearches;
+    if (sample <= 0 || searches % sample != 0)
+        return;
+
+    const QVector<QVector<SearchResult>> exact = searchSegments(nq, topK, queryVectors, nullptr);
+    qint64 hits = 0;
+    qint64 total = 0;
+    for (int q = 0; q < exact.size(); q++) {
+        QSet<faiss::idx_t> exactIDs;
+        for (const SearchResult &res : exact[q])
+            exactIDs.insert(res.id);
+        total += exactIDs.size();
+        for (const SearchResult &res : results.value(q)) {
+            if (exactIDs.contains(res.id))
+                hits++;
         }
-   }
+    }
+    if (total == 0)
+        return;
+
+    const qint64 allHits = recallHits += hits;
+    const qint64 allTotal = recallTotal += total;
+    qInfo() << appID << "two-stage recall@" << topK << ":" << static_cast<double>(hits) / total
+            << "average:" << static_cast<double>(allHits) / allTotal;
+}
 
-   return bitmap;
+TombstoneBitmap *VectorIndex::tombstoneBitmap()
+{
+    QMutexLocker lk(&tombstoneMtx);
+    if (tombstoneLoaded)
+        return &tombstones;
+
+    // 旁路文件在段表提交之后写出，两者之间中断时旁路文件落后于段表；
+    // 旁路文件缺失、损坏或删除计数与段表不一致时由段表重建一次
+    bool loaded = tombstones.load();
+    if (loaded) {
+        QList<QVariantList> result;
+        QString query = "SELECT COUNT(*) FROM " + QString(kEmbeddingDBIndexSegTable)
+                + " WHERE " + QString(kEmbeddingDBSegIndexTableBitSet) + " = 1";
+        {
+            QMutexLocker dbLk(dbMtx);
+            EmbedDBVendorIns->executeQuery(dataBase, query, result);
+        }
+
+        const qint64 dbCount = result.isEmpty() || result[0].isEmpty() ? 0 : result[0][0].toLongLong();
+        if (dbCount != tombstones.count()) {
+            qWarning() << appID << "tombstone count" << tombstones.count() << "mismatch with index segment table" << dbCount;
+            loaded = false;
+        }
+    }
+
+    if (!loaded) {
+        QVector<faiss::idx_t> ids;
+        for (faiss::idx_t id : getDumpDeletedIDs())
+            ids << id;
+        tombstones.reset(ids);
+        tombstones.save();
+        qInfo() << appID << "rebuild tombstones from index segment table:" << ids.size();
+    }
+    tombstoneLoaded = true;
+    return &tombstones;
 }
@@ -5,30 +5,41 @@
 #ifndef VECTORINDEX_H
 #define VECTORINDEX_H
 
+#include "topkheap.h"
+#include "tombstonebitmap.h"
+#include "documentindex.h"
+
 #include <QObject>
 #include <QSharedPointer>
 #include <QStandardPaths>
 #include <QVector>
+#include <QSet>
 
 #include <QSqlDatabase>
 #include <QMutex>
+#include <QReadWriteLock>
 
 #include <faiss/Index.h>
 #include <faiss/IndexFlat.h>
 #include <faiss/IndexIDMap.h>
 
+#include <atomic>
+#include <vector>
+
 class VectorIndex : public QObject
 {
     Q_OBJECT
 
 public:
     explicit VectorIndex(QSqlDatabase *db, QMutex *mtx, const QString &appID, QObject *parent = nullptr);
-    bool updateIndex(int d, const QMap<faiss::idx_t, QVector<float>> &embedVectorCache);
-    bool saveIndexToFile(const faiss::Index *index, const QString &indexType="All");
+    bool updateIndex(int d, const QMap<faiss::idx_t, QVector<float>> &embedVectorCache,
+                     const QMap<faiss::idx_t, QPair<QString, QString>> &embedDataCache);
+    bool saveIndexToFile(const faiss::Index *index, const QVector<faiss::idx_t> &ids, const QString &indexType="All");
 
     //DB Operate
     void resetCacheIndex(int d, const QMap<faiss::idx_t, QVector<float>> &embedVectorCache);
-    void vectorSearch(int topK, const float *queryVector, QMap<float, faiss::idx_t> &cacheSearchRes, QMap<float, faiss::idx_t> &dumpSearchRes);
+    QVector<SearchResult> vectorSearch(int topK, const float *queryVector);
+    QVector<QVector<SearchResult>> vectorSearch(int nq, int topK, const float *queryVectors);
 
     inline static QString workerDir()
     {
@@ -40,22 +51,71 @@ public:
     QPair<faiss::idx_t, faiss::idx_t> getDumpIndexIDRange();
 
     void doIndexDump();
+
+    bool needCompact();
+    bool doIndexCompact();
+    bool doIvfTier();
+
+    void markDeleted(const QVector<faiss::idx_t> &ids);
+    void removeDocuments(const QStringList &sources);
+    bool rebuildDocumentIndex();
+
+    static faiss::MetricType metricType(const QString &appID);
 signals:
     void indexDump();
 private:
-    QHash<QString, int> getIndexFilesNum();
-    QVector<uint8_t> getDumpDeleteBitSet();
+    QMap<int, QString> getIndexFiles(const QString &indexType);
+    int nextIndexFileNum(const QString &indexType);
+    TombstoneBitmap *tombstoneBitmap();
+    DocumentIndex *documentIndex();
+    bool saveDocumentIndex();
+    bool metaDataStamp(qint64 &count, qint64 &lastID);
+    bool selectCandidates(int nq, const float *queryVectors, std::vector<faiss::idx_t> &candidates);
+    QVector<QVector<SearchResult>> searchSegments(int nq, int topK, const float *queryVectors,
+                                                  const std::vector<faiss::idx_t> *candidates);
+    void sampleRecall(int nq, int topK, const float *queryVectors, const QVector<QVector<SearchResult>> &results);
+    QSet<faiss::idx_t> getDumpDeletedIDs();
+    bool segmentHasTombstone(const QString &name);
+    void collectSegmentVectors(const QList<QSharedPointer<faiss::Index>> &indexes, const QSet<faiss::idx_t> &deletedIDs,
+                               QVector<float> &embeddings, QVector<faiss::idx_t> &ids);
+    bool matchMetric(const faiss::Index *index, const QString &name);
+    faiss::Index *createSegmentIndex(int d, faiss::idx_t n, const float *embeddings, const faiss::idx_t *ids);
+    bool writeSegmentFile(const faiss::Index *index, const QString &path);
+    void restoreCacheIndex(faiss::IndexIDMap *index, const QVector<faiss::idx_t> &ids);
+    bool replaceSegments(const QStringList &oldNames, const QString &newName);
+    double ivfRecall(const faiss::Index *ivfIndex, const QVector<float> &embeddings,
+                     const QVector<faiss::idx_t> &ids, int nprobe);
 
     faiss::IndexIDMap *cacheIndex = nullptr;
+    faiss::IndexIDMap *dumpingIndex = nullptr;   // 正在落盘的内存索引，段文件写出前仍参与检索
     QVector<faiss::idx_t> segmentIds;
+    int restoredCount = 0;   // 内存索引前部落盘失败退回的向量个数
     QPair<faiss::idx_t, faiss::idx_t> dumpIndexIDRange;
 
     QSqlDatabase *dataBase = nullptr;
     QMutex *dbMtx = nullptr;
 
     QMutex vectorIndexMtx;
+    QReadWriteLock segmentLock;
+
+    TombstoneBitmap tombstones;
+    bool tombstoneLoaded = false;
+    QMutex tombstoneMtx;
+
+    DocumentIndex documents;
+    bool documentsLoaded = false;
+    bool documentsRebuild = false;   // 旁路文件缺失或损坏，待由落盘段重建
+    QMutex documentsMtx;
+
+    // 两阶段检索的抽样召回统计
+    std::atomic<qint64> twoStageSearches { 0 };
+    std::atomic<qint64> recallHits { 0 };
+    std::atomic<qint64> recallTotal { 0 };
 
     QString appID;
+    faiss::MetricType metric = faiss::METRIC_L2;
+    QSet<QString> metricSkipped;   // 已告警过的度量不符的段
+    QMutex metricSkippedMtx;
 };
 
 #endif // VECTORINDEX_H
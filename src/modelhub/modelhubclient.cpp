@@ -0,0 +1,193 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "modelhubclient.h"
+
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QDebug>
+
+ModelhubClient::ModelhubClient(int maxInFlight, QObject *parent)
+    : QObject(parent)
+    , maxInFlight(qMax(1, maxInFlight))
+{
+    context = new QObject;
+    context->moveToThread(&workThread);
+    connect(&workThread, &QThread::finished, context, &QObject::deleteLater);
+    workThread.setObjectName("modelhub-client");
+    workThread.start();
+
+    // QNetworkAccessManager 必须在使用它的线程中创建
+    QMetaObject::invokeMethod(context, [this]() {
+        manager = new QNetworkAccessManager(context);
+    }, Qt::BlockingQueuedConnection);
+}
+
+ModelhubClient::~ModelhubClient()
+{
+    QMetaObject::invokeMethod(context, [this]() { shutdown(); }, Qt::BlockingQueuedConnection);
+    workThread.quit();
+    workThread.wait();
+}
+
+void ModelhubClient::get(const QString &url, int timeoutMs, const Callback &cb)
+{
+    Task task;
+    task.op = QNetworkAccessManager::GetOperation;
+    task.url = url;
+    task.timeoutMs = timeoutMs;
+    task.cb = cb;
+    enqueue(task);
+}
+
+void ModelhubClient::post(const QString &url, const QByteArray &body, int timeoutMs, const Callback &cb)
+{
+    Task task;
+    task.op = QNetworkAccessManager::PostOperation;
+    task.url = url;
+    task.body = body;
+    task.timeoutMs = timeoutMs;
+    task.cb = cb;
+    enqueue(task);
+}
+
+bool ModelhubClient::getSync(const QString &url, int timeoutMs, QByteArray &out, int *status)
+{
+    Task task;
+    task.op = QNetworkAccessManager::GetOperation;
+    task.url = url;
+    task.timeoutMs = timeoutMs;
+    return waitFor(task, out, status);
+}
+
+bool ModelhubClient::postSync(const QString &url, const QByteArray &body, int timeoutMs, QByteArray &out,
+                              int *status, bool urgent)
+{
+    Task task;
+    task.op = QNetworkAccessManager::PostOperation;
+    task.url = url;
+    task.body = body;
+    task.timeoutMs = timeoutMs;
+    task.urgent = urgent;
+    return waitFor(task, out, status);
+}
+
+void ModelhubClient::enqueue(const Task &task)
+{
+    if (stopped) {
+        if (task.cb)
+            task.cb(false, 0, {});
+        return;
+    }
+
+    QMetaObject::invokeMethod(context, [this, task]() {
+        if (stopped) {
+            if (task.cb)
+                task.cb(false, 0, {});
+            return;
+        }
+        if (task.urgent) {
+            // 插到已排队的紧急请求之后、普通请求之前
+            int pos = 0;
+            while (pos < pending.size() && pending.at(pos).urgent)
+                pos++;
+            pending.insert(pos, task);
+        } else {
+            pending.enqueue(task);
+        }
+        dispatch();
+    }, Qt::QueuedConnection);
+}
+
+bool ModelhubClient::waitFor(const Task &task, QByteArray &out, int *status)
+{
+    Q_ASSERT(QThread::currentThread() != &workThread);
+
+    struct SyncState
+    {
+        QSemaphore done;
+        bool ok = false;
+        int status = 0;
+        QByteArray data;
+    };
+
+    // 回调持有状态的引用，调用方提前返回也不会访问失效内存
+    QSharedPointer<SyncState> state(new SyncState);
+    Task syncTask = task;
+    syncTask.cb = [state](bool ok, int status, const QByteArray &data) {
+        state->ok = ok;
+        state->status = status;
+        state->data = data;
+        state->done.release();
+    };
+    enqueue(syncTask);
+
+    state->done.acquire();
+    out = state->data;
+    if (status)
+        *status = state->status;
+    return state->ok;
+}
+
+void ModelhubClient::dispatch()
+{
+    while (!pending.isEmpty()) {
+        // 紧急请求可多占一个连接，仍在 QNetworkAccessManager 单主机的连接数之内
+        const int limit = pending.head().urgent ? maxInFlight + 1 : maxInFlight;
+        if (running.size() >= limit)
+            break;
+
+        Task task = pending.dequeue();
+
+        QNetworkRequest request { QUrl(task.url) };
+        if (task.urgent)
+            request.setPriority(QNetworkRequest::HighPriority);
+        QNetworkReply *reply = nullptr;
+        if (task.op == QNetworkAccessManager::PostOperation) {
+            request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+            reply = manager->post(request, task.body);
+        } else {
+            reply = manager->get(request);
+        }
+
+        running.insert(reply);
+        if (task.timeoutMs > 0)
+            QTimer::singleShot(task.timeoutMs, reply, &QNetworkReply::abort);
+
+        Callback cb = task.cb;
+        connect(reply, &QNetworkReply::finished, context, [this, reply, cb]() {
+            running.remove(reply);
+            bool ok = reply->error() == QNetworkReply::NoError;
+            int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            // 失败时保留服务返回的错误内容，调用方据此区分失败原因
+            QByteArray data = reply->readAll();
+            if (!ok)
+                qWarning() << "modelhub request failed:" << reply->url() << reply->errorString();
+            reply->deleteLater();
+
+            if (cb)
+                cb(ok, status, data);
+            dispatch();
+        });
+    }
+}
+
+void ModelhubClient::shutdown()
+{
+    // 排队中的请求直接失败，已发出的请求中止，保证同步调用方都能返回
+    stopped = true;
+    QQueue<Task> tasks;
+    tasks.swap(pending);
+    for (const Task &task : tasks) {
+        if (task.cb)
+            task.cb(false, 0, {});
+    }
+
+    const QSet<QNetworkReply *> replies = running;
+    for (QNetworkReply *reply : replies)
+        reply->abort();
+}
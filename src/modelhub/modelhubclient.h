@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: 2024 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef MODELHUBCLIENT_H
+#define MODELHUBCLIENT_H
+
+#include <QObject>
+#include <QThread>
+#include <QQueue>
+#include <QSet>
+#include <QNetworkAccessManager>
+
+#include <atomic>
+#include <functional>
+
+class QNetworkReply;
+
+// 访问模型服务的常驻 HTTP 客户端：在独立线程中复用同一个 QNetworkAccessManager 以保持长连接，
+// 最多同时发出 maxInFlight 个请求，其余排队；回调在客户端线程执行
+// 紧急请求(检索)排在普通请求之前，并可额外占用一个连接，不必等待批量入库的请求完成
+class ModelhubClient : public QObject
+{
+    Q_OBJECT
+public:
+    // status 为 HTTP 状态码，连接失败或超时为 0；失败时 data 为服务返回的错误内容
+    typedef std::function<void(bool ok, int status, const QByteArray &data)> Callback;
+
+    explicit ModelhubClient(int maxInFlight, QObject *parent = nullptr);
+    ~ModelhubClient();
+
+    void get(const QString &url, int timeoutMs, const Callback &cb);
+    void post(const QString &url, const QByteArray &body, int timeoutMs, const Callback &cb);
+
+    // 阻塞调用线程直至完成，等待的是信号量而不是嵌套事件循环；不能在客户端线程调用
+    bool getSync(const QString &url, int timeoutMs, QByteArray &out, int *status = nullptr);
+    bool postSync(const QString &url, const QByteArray &body, int timeoutMs, QByteArray &out,
+                  int *status = nullptr, bool urgent = false);
+
+private:
+    struct Task
+    {
+        QNetworkAccessManager::Operation op = QNetworkAccessManager::GetOperation;
+        QString url;
+        QByteArray body;
+        int timeoutMs = 0;
+        bool urgent = false;
+        Callback cb;
+    };
+
+    void enqueue(const Task &task);
+    bool waitFor(const Task &task, QByteArray &out, int *status);
+    void dispatch();
+    void shutdown();
+
+    QThread workThread;
+    QObject *context = nullptr;   // 属于 workThread，下列成员只在该线程访问
+    QNetworkAccessManager *manager = nullptr;
+    QQueue<Task> pending;
+    QSet<QNetworkReply *> running;
+    int maxInFlight = 1;
+    std::atomic_bool stopped { false };
+};
+
+#endif // MODELHUBCLIENT_H
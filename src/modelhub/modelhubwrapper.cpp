@@ -8,21 +8,23 @@
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QNetworkRequest>
+#include <QDateTime>
 #include <QThread>
-#include <QEventLoop>
 #include <QFileInfo>
 #include <QProcess>
 
 #include <unistd.h>
 
+static constexpr int kClientMaxInFlight { 4 };   // 不超过 QNetworkAccessManager 单主机 6 个连接
+static constexpr qint64 kHealthTTL { 10 * 1000 };   // ms，健康状态缓存时间
+static constexpr int kHealthTimeout { 3000 };   // ms
+
 ModelhubWrapper::ModelhubWrapper(const QString &model, QObject *parent)
     : QObject(parent)
     , modelName(model)
 {
     Q_ASSERT(!model.isEmpty());
+    httpClient = new ModelhubClient(kClientMaxInFlight, this);
 }
 
 ModelhubWrapper::~ModelhubWrapper()
@@ -106,20 +108,27 @@ bool ModelhubWrapper::health()
         return false;
     lk.unlock();
 
-    QUrl url = urlPath("/health");
-
-    QNetworkAccessManager manager;
-    QNetworkRequest request(url);
+    // 只缓存成功的结果，失败时每次都重新探测以便及时拉起服务
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - healthyTime < kHealthTTL)
+        return true;
 
-    QNetworkReply *reply = manager.get(request);
-    if (!reply)
+    QByteArray out;
+    if (!httpClient->getSync(urlPath("/health"), kHealthTimeout, out))
         return false;
 
-    QEventLoop loop;
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-    reply->deleteLater();
-    return reply->error() == QNetworkReply::NoError;
+    healthyTime = now;
+    return true;
+}
+
+void ModelhubWrapper::invalidateHealth()
+{
+    healthyTime = 0;
+}
+
+ModelhubClient *ModelhubWrapper::client() const
+{
+    return httpClient;
 }
 
 QString ModelhubWrapper::urlPath(const QString &api) const
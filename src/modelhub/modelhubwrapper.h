@@ -4,9 +4,13 @@
 //
 // SPDX-License-Identifier: GPL-3.0-or-later
 
+#include "modelhubclient.h"
+
 #include <QObject>
 #include <QReadWriteLock>
 
+#include <atomic>
+
 class ModelhubWrapper : public QObject
 {
     Q_OBJECT
@@ -16,6 +20,8 @@ public:
     bool isRunning();
     bool ensureRunning();
     bool health();
+    void invalidateHealth();
+    ModelhubClient *client() const;
     QString urlPath(const QString &api) const;
     static bool isModelhubInstalled();
     static bool isModelInstalled(const QString &model);
@@ -30,5 +36,7 @@ protected:
     bool started = false;
     qint64 pid = -1;
     mutable QReadWriteLock lock;
+    ModelhubClient *httpClient = nullptr;
+    std::atomic<qint64> healthyTime { 0 };   // 最近一次探测成功的时间，ms
 };
 #endif   // MODELHUBWRAPPER_H
@@ -5,19 +5,22 @@
 #include "vectorindexdbus.h"
 #include "config/configmanager.h"
 #include "index/global_define.h"
+#include "index/vectorindex/queryembeddingcache.h"
+#include "index/vectorindex/chunkembeddingcache.h"
+#include "index/vectorindex/embeddingdecoder.h"
+#include "index/vectorindex/lanescheduler.h"
 
 #include <QCoreApplication>
 #include <QDebug>
 #include <QThread>
 #include <QDBusConnection>
-#include <QEventLoop>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QDir>
 
+static constexpr int kEmbeddingTimeout { 60 * 1000 };   // ms，单次向量化请求超时
+
 VectorIndexDBus::VectorIndexDBus(QObject *parent) : QObject(parent)
 {
     m_whiteList << kGrandVectorSearch;
@@ -28,10 +31,15 @@ VectorIndexDBus::VectorIndexDBus(QObject *parent) : QObject(parent)
 
 VectorIndexDBus::~VectorIndexDBus()
 {
+    QueryEmbeddingCacheIns->save();
+
     for (auto it : embeddingWorkerwManager.values()) {
         delete it;
         it = nullptr;
     }
+
+    delete backend;
+    backend = nullptr;
 }
 
 bool VectorIndexDBus::Create(const QString &appID, const QStringList &files)
@@ -60,6 +68,9 @@ bool VectorIndexDBus::Delete(const QString &appID, const QStringList &files)
 
 bool VectorIndexDBus::Enable()
 {
+    if (backend)
+        return backend->isAvailable();
+
     return (bgeModel->isRunning()) || (ModelhubWrapper::isModelhubInstalled() &&
                                        ModelhubWrapper::isModelInstalled(dependModel()));
 }
@@ -82,6 +93,15 @@ QString VectorIndexDBus::Search(const QString &appID, const QString &query, int
     return embeddingWorker->doVectorSearch(query, topK);;
 }
 
+QString VectorIndexDBus::SearchBatch(const QString &appID, const QStringList &queries, int topK)
+{
+    EmbeddingWorker *embeddingWorker = ensureWorker(appID);
+    if (!embeddingWorker)
+        return "";
+
+    return embeddingWorker->doVectorSearchBatch(queries, topK);
+}
+
 QString VectorIndexDBus::getAutoIndexStatus(const QString &appID)
 {
     EmbeddingWorker *embeddingWorker = ensureWorker(appID);
@@ -100,6 +120,10 @@ QString VectorIndexDBus::getAutoIndexStatus(const QString &appID)
     if (st == 1) {
         qint64 time = embeddingWorker->getIndexUpdateTime();
         hash.insert("updatetime", time);
+    } else {
+        // 批量入库各级吞吐与遍历进度
+        hash.insert("pipeline", embeddingWorker->ingestStats());
+        hash.insert("progress", embeddingWorker->crawlProgress());
     }
 
     QString str = QString::fromUtf8(QJsonDocument(QJsonObject::fromVariantHash(hash)).toJson());
@@ -149,17 +173,48 @@ EmbeddingWorker *VectorIndexDBus::ensureWorker(const QString &appID)
     return worker;
 }
 
-QJsonObject VectorIndexDBus::embeddingApi(const QStringList &texts, void *user)
+QByteArray VectorIndexDBus::embeddingApi(const QStringList &texts, void *user)
 {
     VectorIndexDBus *self = static_cast<VectorIndexDBus *>(user);
     if (!self->bgeModel->ensureRunning()) {
         return {};
     }
 
-    QNetworkAccessManager manager;
-    QNetworkRequest request(self->bgeModel->urlPath("/embeddings"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    int format = self->wireFormat;
+    forever {
+        // 复用模型服务的常驻连接，调用线程等待结果而不进入嵌套事件循环；检索的请求优先发送
+        QByteArray response;
+        int status = 0;
+        if (self->bgeModel->client()->postSync(self->bgeModel->urlPath("/embeddings"),
+                                               embeddingRequest(texts, format),
+                                               kEmbeddingTimeout, response, &status,
+                                               LaneScheduler::inQuery())) {
+            // 服务忽略了 encoding_format 时按实际返回的编码继续
+            int replied = EmbeddingDecoder::encoding(response);
+            if (replied != format) {
+                qInfo() << "embedding wire format" << format << "is answered with" << replied;
+                self->wireFormat = replied;
+            }
+            qDebug() << "Response ok";
+            return response;
+        }
+
+        // 只有服务明确拒绝 encoding_format 时才降级重试；413 等其他失败直接返回，由批次调整处理
+        if (format != EmbeddingDecoder::Float && status == 400 && response.contains("encoding_format")) {
+            format = format == EmbeddingDecoder::Base64 ? EmbeddingDecoder::Float : EmbeddingDecoder::Base64;
+            qInfo() << "embedding wire format is rejected with" << status << ", fall back to" << format;
+            self->wireFormat = format;
+            continue;
+        }
+
+        qDebug() << "Failed to create data" << status;
+        self->bgeModel->invalidateHealth();
+        return {};
+    }
+}
 
+QByteArray VectorIndexDBus::embeddingRequest(const QStringList &texts, int format)
+{
     QJsonArray jsonArray;
     for (const QString &str : texts) {
         jsonArray.append(str);
@@ -169,28 +224,31 @@ QJsonObject VectorIndexDBus::embeddingApi(const QStringList &texts, void *user)
     QJsonObject data;
     data["input"] = jsonValue;
 
-    QJsonDocument jsonDocHttp(data);
-    QByteArray jsonDataHttp = jsonDocHttp.toJson();
-    QJsonDocument replyJson;
-    QNetworkReply *reply = manager.post(request, jsonDataHttp);
-
-    QEventLoop loop;
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    loop.exec();
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray response = reply->readAll();
-        replyJson = QJsonDocument::fromJson(response);
-        qDebug() << "Response ok";
-    } else {
-        qDebug() << "Failed to create data:" << reply->errorString();
+    switch (format) {
+    case EmbeddingDecoder::Base64:
+        data["encoding_format"] = "base64";
+        break;
+    case EmbeddingDecoder::Binary:
+        data["encoding_format"] = "binary";
+        break;
+    case EmbeddingDecoder::BinaryFp16:
+        data["encoding_format"] = "binary_fp16";
+        break;
+    default:
+        break;
     }
-    reply->deleteLater();
-    QJsonObject obj = {};
-    if (replyJson.isObject()) {
-        obj = replyJson.object();
-        return obj;
-    }
-    return {};
+
+    QJsonDocument jsonDocHttp(data);
+    return jsonDocHttp.toJson(QJsonDocument::Compact);
+}
+
+QString VectorIndexDBus::getQueryCacheStatus()
+{
+    QJsonObject obj;
+    obj["hits"] = QueryEmbeddingCacheIns->hits();
+    obj["misses"] = QueryEmbeddingCacheIns->misses();
+    obj["size"] = QueryEmbeddingCacheIns->size();
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
 }
 
 void VectorIndexDBus::initBgeModel()
@@ -205,11 +263,39 @@ void VectorIndexDBus::initBgeModel()
     });
 
     bgeModel = new ModelhubWrapper(dependModel(), this);
+
+    // 可选的进程内后端，不同后端的向量不可混用，缓存按模型区分
+    const QString backendName = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_BACKEND,
+                                                        QString("modelhub")).toString();
+    backend = EmbeddingBackend::create(backendName);
+    const QString model = backend ? backend->model() : dependModel();
+    qInfo() << "embedding backend" << (backend ? backendName : QString("modelhub")) << "model" << model;
+    QueryEmbeddingCacheIns->setModel(model);
+    ChunkEmbeddingCacheIns->setModel(model);
 }
 
 void VectorIndexDBus::init()
 {    
     initBgeModel();
+
+    // 默认先尝试无损的二进制帧，服务不支持时逐级降级到 JSON
+    const QString format = ConfigManagerIns->value(VECTOR_INDEX_GROUP, VECTOR_INDEX_EMBED_WIRE_FORMAT, "auto").toString();
+    if (format == "float")
+        wireFormat = EmbeddingDecoder::Float;
+    else if (format == "base64")
+        wireFormat = EmbeddingDecoder::Base64;
+    else if (format == "fp16")
+        wireFormat = EmbeddingDecoder::BinaryFp16;
+    else
+        wireFormat = EmbeddingDecoder::Binary;
+
+    // 定期落盘查询向量缓存，未变化时不写文件
+    QTimer *cacheTimer = new QTimer(this);
+    cacheTimer->setInterval(10 * 60 * 1000);
+    connect(cacheTimer, &QTimer::timeout, this, []() {
+        QueryEmbeddingCacheIns->save();
+    });
+    cacheTimer->start();
     for (const QString &app : m_whiteList) {
          bool on = ConfigManagerIns->value(AUTO_INDEX_GROUP, app + "." + AUTO_INDEX_STATUS, false).toBool();
          if (!on)
@@ -217,6 +303,10 @@ void VectorIndexDBus::init()
 
          auto work = ensureWorker(app);
          work->setWatch(true);
+
+         // 上次全量索引未完成，从断点继续
+         if (work->hasCrawlCheckpoint())
+             QMetaObject::invokeMethod(work, "onCreateAllIndex");
     }
 }
 
@@ -225,7 +315,10 @@ void VectorIndexDBus::initEmbeddingWorker(EmbeddingWorker *ew)
     if (!ew)
         return;
 
-    ew->setEmbeddingApi(embeddingApi, this);
+    if (backend)
+        ew->setEmbeddingApi(EmbeddingBackend::embeddingApi, backend);
+    else
+        ew->setEmbeddingApi(embeddingApi, this);
     connect(ew, &EmbeddingWorker::statusChanged, this, &VectorIndexDBus::IndexStatus);
     connect(ew, &EmbeddingWorker::indexDeleted, this, &VectorIndexDBus::IndexDeleted);
 }
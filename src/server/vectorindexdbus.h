@@ -7,12 +7,15 @@
 
 #include "index/embeddingworker.h"
 #include "modelhub/modelhubwrapper.h"
+#include "index/vectorindex/embeddingbackend.h"
 
 #include <QObject>
 #include <QDBusMessage>
 #include <QProcess>
 #include <QThread>
 
+#include <atomic>
+
 class VectorIndexDBus : public QObject
 {
     Q_OBJECT    
@@ -29,6 +32,7 @@ public Q_SLOTS:
     bool Create(const QString &appID, const QStringList &files);
     bool Delete(const QString &appID, const QStringList &files);
     QString Search(const QString &appID, const QString &query, int topK);
+    QString SearchBatch(const QString &appID, const QStringList &queries, int topK);
 
     bool Enable();
     QString DocFiles(const QString &appID);
@@ -37,6 +41,7 @@ public Q_SLOTS:
     void setAutoIndex(const QString &appID, bool on);
 
     void saveAllIndex(const QString &appID);
+    QString getQueryCacheStatus();
 
     void initBgeModel();
 
@@ -47,12 +52,15 @@ signals:
 private:
     EmbeddingWorker *ensureWorker(const QString &appID);
 protected:
-    static QJsonObject embeddingApi(const QStringList &texts, void *user);
+    static QByteArray embeddingApi(const QStringList &texts, void *user);
+    static QByteArray embeddingRequest(const QStringList &texts, int format);
 
 private:
     ModelhubWrapper *bgeModel = nullptr;
+    EmbeddingBackend *backend = nullptr;   // 进程内后端，为空时经 modelhub 向量化
     QMap<QString, EmbeddingWorker*> embeddingWorkerwManager;
     QList<QString> m_whiteList;
+    std::atomic<int> wireFormat { 0 };   // 与模型服务协商的响应编码，EmbeddingDecoder::Encoding
 
     void init();
     void initEmbeddingWorker(EmbeddingWorker *ew);
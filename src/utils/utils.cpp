@@ -4,13 +4,23 @@
 
 #include "utils.h"
 
-#include <QTextStream>
 #include <QTextCodec>
 #include <QMimeDatabase>
+#include <QHash>
 #include <QDebug>
 
 #include <uchardet/uchardet.h>
 
+static constexpr qint64 kContentSampleSize { 64 * 1024 };   // 编码与文本类型检测的采样长度
+
+namespace {
+struct CharsetDetector
+{
+    uchardet_t ud = uchardet_new();
+    ~CharsetDetector() { uchardet_delete(ud); }
+};
+}
+
 Utils::Utils(QObject *parent) : QObject(parent)
 {
 
@@ -21,28 +31,22 @@ QString Utils::textEncodingTransferUTF8(const std::string &content)
     if (content.empty())
         return {};
 
-    QByteArray data = QByteArray::fromStdString(content);
-    uchardet_t ud = uchardet_new();
-    uchardet_handle_data(ud, data.constData(), static_cast<size_t>(data.size()));
-    uchardet_data_end(ud);
-    const char *codec = uchardet_get_charset(ud);
-    if (codec == QString("UTF-8"))
-        return QString::fromStdString(content);
-    QTextCodec *oldCodec = QTextCodec::codecForName(codec);
-    uchardet_delete(ud);
-
-    QTextStream oldEncoding(data);
-    oldEncoding.setCodec(oldCodec);
-
-    return oldEncoding.readAll();
+    QTextCodec *codec = codecForData(content.data(), static_cast<qint64>(content.size()));
+    return codec->toUnicode(content.data(), static_cast<int>(content.size()));
 }
 
 bool Utils::isValidContent(const std::string &content)
 {
-    QByteArray data = QByteArray::fromStdString(content);
+    return isValidContent(content.data(), static_cast<qint64>(content.size()));
+}
+
+bool Utils::isValidContent(const char *data, qint64 size)
+{
+    // mime 检测只依赖开头的数据
+    QByteArray sample = QByteArray::fromRawData(data, static_cast<int>(qMin(size, kContentSampleSize)));
 
     QMimeDatabase mimeDB;
-    QMimeType mimeType = mimeDB.mimeTypeForData(data);
+    QMimeType mimeType = mimeDB.mimeTypeForData(sample);
     if (!mimeType.isValid())
         return false;
 
@@ -51,3 +55,31 @@ bool Utils::isValidContent(const std::string &content)
 
     return false;
 }
+
+QTextCodec *Utils::codecForData(const char *data, qint64 size)
+{
+    // 开头的 ASCII 对判断编码没有帮助，从第一个非 ASCII 字节开始采样
+    qint64 start = 0;
+    while (start < size && !(static_cast<uchar>(data[start]) & 0x80))
+        start++;
+    if (start == size)
+        return QTextCodec::codecForName("UTF-8");
+
+    // 每个线程复用一个 uchardet 实例
+    static thread_local CharsetDetector detector;
+    uchardet_reset(detector.ud);
+    uchardet_handle_data(detector.ud, data + start, static_cast<size_t>(qMin(size - start, kContentSampleSize)));
+    uchardet_data_end(detector.ud);
+    const QByteArray charset(uchardet_get_charset(detector.ud));
+
+    static thread_local QHash<QByteArray, QTextCodec *> codecs;
+    auto it = codecs.constFind(charset);
+    if (it != codecs.constEnd())
+        return it.value();
+
+    QTextCodec *codec = QTextCodec::codecForName(charset);
+    if (!codec)
+        codec = QTextCodec::codecForLocale();
+    codecs.insert(charset, codec);
+    return codec;
+}
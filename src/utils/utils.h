@@ -7,6 +7,8 @@
 
 #include <QObject>
 
+class QTextCodec;
+
 class Utils : public QObject
 {
     Q_OBJECT
@@ -16,6 +18,10 @@ public:
 
     static QString textEncodingTransferUTF8(const std::string &content);
     static bool isValidContent(const std::string &content);
+    // 以下只检查数据开头的采样，不复制数据
+    static bool isValidContent(const char *data, qint64 size);
+    // 无法识别时返回本地编码
+    static QTextCodec *codecForData(const char *data, qint64 size);
 };
 
 #endif // UTILS_H